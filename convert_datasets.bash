@@ -0,0 +1,10 @@
+#!/bin/bash
+# Rewrites every dataset as binary_little_endian PLY, which learnply loads in bulk.
+# Pass -ascii to convert them back to text.
+# The files are replaced in place, so make sure the tree is committed first.
+
+format=${1:--binary}
+
+for ply in ./datasets/*/*.ply; do
+	./Release/learnply.exe "$format" "$ply" || echo "failed to convert $ply"
+done
@@ -0,0 +1,74 @@
+/*
+
+Bump allocator for mesh elements
+
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include "arena.h"
+
+/* blocks made by alloc() when nothing was reserved; reserve() sizes its own */
+static const size_t MIN_BLOCK = 1 << 16;
+
+/* block headers are padded so the data after them is aligned for anything */
+static const size_t HEADER = (sizeof(void*) * 3 + 15) & ~(size_t)15;
+
+Arena::Arena()
+{
+	head = NULL;
+	total = 0;
+}
+
+Arena::~Arena()
+{
+	release();
+}
+
+void Arena::add_block(size_t bytes)
+{
+	Block* block = (Block*)malloc(HEADER + bytes);
+	if (block == NULL) {
+		fprintf(stderr, "Out of memory allocating %zu bytes for the mesh.\n", bytes);
+		exit(-1);
+	}
+	block->prev = head;
+	block->size = bytes;
+	block->used = 0;
+	head = block;
+	total += bytes;
+}
+
+void Arena::reserve(size_t bytes)
+{
+	/* worst case alignment padding for the first allocation */
+	bytes += 16;
+	if (head == NULL || head->size - head->used < bytes)
+		add_block(bytes < MIN_BLOCK ? MIN_BLOCK : bytes);
+}
+
+void* Arena::alloc(size_t bytes, size_t align)
+{
+	if (head != NULL) {
+		size_t offset = (head->used + align - 1) & ~(align - 1);
+		if (offset + bytes <= head->size) {
+			head->used = offset + bytes;
+			return (char*)head + HEADER + offset;
+		}
+	}
+
+	/* doesn't fit; reserve() is what sizes the big blocks */
+	add_block(bytes + align < MIN_BLOCK ? MIN_BLOCK : bytes + align);
+	head->used = bytes;
+	return (char*)head + HEADER;
+}
+
+void Arena::release()
+{
+	while (head) {
+		Block* prev = head->prev;
+		free(head);
+		head = prev;
+	}
+	total = 0;
+}
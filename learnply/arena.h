@@ -0,0 +1,53 @@
+/*
+
+Bump allocator for mesh elements
+
+*/
+
+#ifndef __ARENA_H__
+#define __ARENA_H__
+
+#include <stddef.h>
+
+/// <summary>
+/// Hands out memory from a few large blocks and frees it all at once. Nothing allocated from an arena is destructed,
+/// so it's only meant for the plain mesh classes (Vertex, Quad, Edge and their pointer rings).
+/// </summary>
+class Arena {
+public:
+	Arena();
+	~Arena();
+
+	/// <summary>
+	/// Makes sure the next bytes worth of allocations come from one contiguous block.
+	/// </summary>
+	void reserve(size_t bytes);
+
+	void* alloc(size_t bytes, size_t align);
+
+	template <class T> T* alloc_array(size_t n) { return (T*)alloc(sizeof(T) * n, alignof(T)); }
+
+	/// <summary>
+	/// Frees every block. O(number of blocks), however many elements were carved from them.
+	/// </summary>
+	void release();
+
+	size_t allocated() const { return total; }
+
+private:
+	Arena(const Arena&);
+	Arena& operator=(const Arena&);
+
+	struct Block {
+		Block* prev;
+		size_t size;
+		size_t used;
+	};
+
+	Block* head;
+	size_t total;		/* bytes in all blocks */
+
+	void add_block(size_t bytes);
+};
+
+#endif /* __ARENA_H__ */
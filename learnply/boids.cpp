@@ -0,0 +1,492 @@
+/*
+
+Native reader for raw boids simulator logs
+
+Port of BoidsExperiment (transformer/boidsTransformer) so learnply can open
+the logs without the .NET transformer.
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <string>
+#include <charconv>
+#include <thread>
+#include "polyhedron.h"
+#include "mapped_file.h"
+#include "structured_grid.h"
+#include "boids.h"
+
+/******************************************************************************
+Parse one number of the log. The simulator writes thousands separators
+("-1,004.539"), which float.Parse accepted, so those are stripped before
+converting; everything else goes straight through from_chars.
+
+Entry:
+  p   - start of the number
+  end - end of the line
+
+Exit:
+  returns the character after the number, or NULL if there is no number
+******************************************************************************/
+static const char* parse_log_number(const char* p, const char* end, float* value)
+{
+	std::from_chars_result r = std::from_chars(p, end, *value);
+	if (r.ec != std::errc())
+		return NULL;
+	if (r.ptr == end || *r.ptr != ',')
+		return r.ptr;
+
+	char buffer[64];
+	int n = 0;
+	const char* q = p;
+	while (q < end && n < (int)sizeof(buffer)) {
+		char c = *q;
+		if ((c >= '0' && c <= '9') || c == '.' || c == '-' || c == 'e' || c == 'E')
+			buffer[n++] = c;
+		else if (c != ',')
+			break;
+		q++;
+	}
+	r = std::from_chars(buffer, buffer + n, *value);
+	if (r.ec != std::errc() || r.ptr != buffer + n)
+		return NULL;
+	return q;
+}
+
+/******************************************************************************
+Parse a single snapshot line into the end of the log.
+******************************************************************************/
+static bool parse_log_line(const char* p, const char* end, BoidsLog& log)
+{
+	float t, bx, by;
+
+	p = parse_log_number(p, end, &t);
+	if (p == NULL || p >= end || *p != ':')
+		return false;
+	p++;
+
+	while (p < end) {
+		p = parse_log_number(p, end, &bx);
+		if (p == NULL || p >= end || *p != ';')
+			return false;
+		p = parse_log_number(p + 1, end, &by);
+		if (p == NULL || p >= end || *p != '#')
+			return false;
+		p++;
+
+		log.x.push_back(bx);
+		log.y.push_back(by);
+	}
+
+	log.time.push_back(t);
+	log.first.push_back((unsigned int)log.x.size());
+	return true;
+}
+
+/* a run of whole lines of the log, parsed by one thread */
+struct LogChunk {
+	const char* begin;
+	const char* end;
+	BoidsLog part;		/* offsets in part.first are local to the chunk */
+	int lines;
+	int bad_line;		/* local index of the first line that didn't parse, or -1 */
+};
+
+static void parse_log_chunk(LogChunk* chunk)
+{
+	const char* p = chunk->begin;
+	const char* end = chunk->end;
+
+	/* about 16 bytes per boid in the logs we have */
+	size_t guess = (end - p) / 16;
+	chunk->part.x.reserve(guess);
+	chunk->part.y.reserve(guess);
+	chunk->part.first.assign(1, 0);
+	chunk->lines = 0;
+	chunk->bad_line = -1;
+
+	while (p < end) {
+		const char* eol = (const char*)memchr(p, '\n', end - p);
+		if (eol == NULL)
+			eol = end;
+		const char* stop = eol;
+		if (stop > p && stop[-1] == '\r')
+			stop--;
+
+		/* allow blank lines, in particular the one at EOF */
+		if (stop > p && !parse_log_line(p, stop, chunk->part)) {
+			chunk->bad_line = chunk->lines;
+			return;
+		}
+
+		p = eol + 1;
+		chunk->lines++;
+	}
+}
+
+bool read_boids_log(const char* path, BoidsLog& log)
+{
+	MappedFile file;
+	if (!file.open(path))
+		return false;
+
+	const char* text = file.data();
+	size_t size = file.size();
+
+	/* split at line boundaries; small logs aren't worth more than one thread */
+	const size_t min_chunk = 1 << 18;
+	size_t nchunks = std::thread::hardware_concurrency();
+	if (nchunks == 0)
+		nchunks = 1;
+	if (nchunks > size / min_chunk)
+		nchunks = size / min_chunk > 0 ? size / min_chunk : 1;
+
+	std::vector<LogChunk> chunks(nchunks);
+	const char* p = text;
+	for (size_t i = 0; i < nchunks; i++) {
+		const char* stop = text + size;
+		if (i < nchunks - 1) {
+			const char* split = text + size / nchunks * (i + 1);
+			if (split < p)
+				split = p;
+			const char* eol = (const char*)memchr(split, '\n', text + size - split);
+			if (eol != NULL)
+				stop = eol + 1;
+		}
+		chunks[i].begin = p;
+		chunks[i].end = stop;
+		p = stop;
+	}
+
+	std::vector<std::thread> workers;
+	for (size_t i = 1; i < nchunks; i++)
+		workers.push_back(std::thread(parse_log_chunk, &chunks[i]));
+	parse_log_chunk(&chunks[0]);
+	for (size_t i = 0; i < workers.size(); i++)
+		workers[i].join();
+
+	/* stitch the chunks together in order */
+	size_t nsnapshots = 0, nboids = 0;
+	int line = 0;
+	for (size_t i = 0; i < nchunks; i++) {
+		if (chunks[i].bad_line >= 0) {
+			fprintf(stderr, "Could not interpret line %d of %s.\n", line + chunks[i].bad_line, path);
+			return false;
+		}
+		line += chunks[i].lines;
+		nsnapshots += chunks[i].part.time.size();
+		nboids += chunks[i].part.x.size();
+	}
+
+	log.time.resize(nsnapshots);
+	log.first.resize(nsnapshots + 1);
+	log.x.resize(nboids);
+	log.y.resize(nboids);
+
+	size_t s = 0, b = 0;
+	for (size_t i = 0; i < nchunks; i++) {
+		const BoidsLog& part = chunks[i].part;
+		std::copy(part.time.begin(), part.time.end(), log.time.begin() + s);
+		std::copy(part.x.begin(), part.x.end(), log.x.begin() + b);
+		std::copy(part.y.begin(), part.y.end(), log.y.begin() + b);
+		for (size_t j = 0; j < part.time.size(); j++)
+			log.first[s + j] = (unsigned int)(b + part.first[j]);
+		s += part.time.size();
+		b += part.x.size();
+	}
+	log.first[nsnapshots] = (unsigned int)nboids;
+
+	return true;
+}
+
+/******************************************************************************
+Increases weights within the grids based on a boid's position therein.
+Port of BoidsExperiment.DistributeBoidWeightOverQuad.
+
+Entry:
+  bx, by  - coordinates of the boid
+  dir     - direction the boid is traveling in (x,y,z)
+  weight  - amount to increase traffic by, in total
+******************************************************************************/
+static void distribute_boid_weight(BoidsGrid& grid, const float cell[2], float bx, float by, const float dir[3], float weight)
+{
+	int size = grid.size;
+	const float* bounds = grid.bounds;
+
+	/* corners of the boid's quad: nw, sw, ne, se */
+	int lx = (int)floorf((bx - bounds[0]) / cell[0]);
+	int ly = (int)floorf((by - bounds[1]) / cell[1]);
+	int ux = (int)ceilf((bx - bounds[0]) / cell[0]);
+	int uy = (int)ceilf((by - bounds[1]) / cell[1]);
+
+	/* the transformer would throw on a boid outside the bounds; ignore it instead */
+	if (lx < 0 || ly < 0 || ux >= size || uy >= size)
+		return;
+
+	int corner[4][2] = { { lx, ly }, { lx, uy }, { ux, ly }, { ux, uy } };
+
+	float distances[4];
+	float distance_sum = 0;
+	for (int i = 0; i < 4; i++) {
+		float dx = (corner[i][0] * cell[0]) + bounds[0] - bx;
+		float dy = (corner[i][1] * cell[1]) + bounds[1] - by;
+		distances[i] = sqrtf(dx * dx + dy * dy);
+		distance_sum += distances[i];
+	}
+
+	for (int i = 0; i < 4; i++) {
+		/* a boid sitting exactly on a vertex has all four corners at distance 0 */
+		float ratio = distance_sum > 0 ? distances[i] / distance_sum : 0.25f;
+		int v = corner[i][0] * size + corner[i][1];
+
+		/* scalar data: relative traffic at that vertex, weighted by time */
+		grid.traffic[v] += weight - (weight * ratio);
+
+		/* vector data: running average of the paths through that vertex.
+		   The weight is bumped once per component, exactly like the transformer. */
+		for (int j = 0; j < 3; j++) {
+			float portion = 1 - ratio;
+			float prev_weight = grid.weight[v];
+			float new_weight = prev_weight + portion;
+			grid.path[v * 3 + j] *= prev_weight;
+			grid.path[v * 3 + j] += dir[j] * portion;
+			grid.path[v * 3 + j] /= new_weight;
+			grid.weight[v] = new_weight;
+		}
+	}
+}
+
+static void clear_grid(const float bounds[4], int gridSize, BoidsGrid& grid)
+{
+	grid.size = gridSize;
+	for (int i = 0; i < 4; i++)
+		grid.bounds[i] = bounds[i];
+	grid.traffic.assign(gridSize * gridSize, 0.0f);
+	grid.path.assign(gridSize * gridSize * 3, 0.0f);
+	grid.weight.assign(gridSize * gridSize, 0.0f);
+}
+
+/* the last snapshot has no successor and is weighted by the average time step */
+static float average_time_step(const BoidsLog& log)
+{
+	int count = log.snapshots();
+	float average_dt = 0;
+	for (int i = 0; i < count - 1; i++)
+		average_dt += log.time[i + 1] - log.time[i];
+	if (count > 1)
+		average_dt /= count - 1;
+	return average_dt;
+}
+
+/******************************************************************************
+Add snapshot i of the log to the grid. Its weight and directions depend only
+on the snapshot and its successor, never on which other snapshots are included.
+******************************************************************************/
+static void rasterize_snapshot(const BoidsLog& log, int i, float average_dt, const float cell[2], BoidsGrid& grid)
+{
+	bool last = (i == log.snapshots() - 1);
+	float dt = last ? average_dt : log.time[i + 1] - log.time[i];
+	int next_boids = last ? 0 : log.boids(i + 1);
+
+	for (int j = 0; j < log.boids(i); j++) {
+		unsigned int b = log.first[i] + j;
+		float dir[3] = { 0, 0, 0 };
+		if (j < next_boids) {
+			unsigned int nb = log.first[i + 1] + j;
+			dir[0] = log.x[nb] - log.x[b];
+			dir[1] = log.y[nb] - log.y[b];
+		}
+		distribute_boid_weight(grid, cell, log.x[b], log.y[b], dir, dt);
+	}
+}
+
+void rasterize_boids(const BoidsLog& log, const float bounds[4], int gridSize, float maxTime, BoidsGrid& grid)
+{
+	clear_grid(bounds, gridSize, grid);
+
+	int count = log.snapshots();
+	if (count == 0)
+		return;
+
+	/* remember: # cells = # vertices - 1 */
+	float cell[2] = {
+		(bounds[2] - bounds[0]) / (gridSize - 1),
+		(bounds[3] - bounds[1]) / (gridSize - 1)
+	};
+	float average_dt = average_time_step(log);
+
+	for (int i = 0; i < count; i++) {
+		/* the log isn't guaranteed to be sorted, so we can't break at maxTime */
+		if (log.time[i] < maxTime)
+			rasterize_snapshot(log, i, average_dt, cell, grid);
+	}
+}
+
+void rasterize_boids(const BoidsLog& log, const float bounds[4], int gridSize, const std::vector<float>& maxTimes, std::vector<BoidsGrid>& grids)
+{
+	int count = log.snapshots();
+	grids.resize(maxTimes.size());
+
+	bool sorted = true;
+	for (int i = 0; i + 1 < count && sorted; i++)
+		sorted = log.time[i] <= log.time[i + 1];
+
+	/* the running average of the paths depends on the order snapshots are added in,
+	   so an unsorted log can only be reproduced exactly by one pass per horizon */
+	if (!sorted) {
+		for (size_t h = 0; h < maxTimes.size(); h++)
+			rasterize_boids(log, bounds, gridSize, maxTimes[h], grids[h]);
+		return;
+	}
+
+	std::vector<size_t> order(maxTimes.size());
+	for (size_t h = 0; h < order.size(); h++)
+		order[h] = h;
+	std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return maxTimes[a] < maxTimes[b]; });
+
+	BoidsGrid grid;
+	clear_grid(bounds, gridSize, grid);
+	float cell[2] = {
+		(bounds[2] - bounds[0]) / (gridSize - 1),
+		(bounds[3] - bounds[1]) / (gridSize - 1)
+	};
+	float average_dt = average_time_step(log);
+
+	/* every horizon at or before this snapshot's time has seen all it will see */
+	size_t next = 0;
+	for (int i = 0; i < count; i++) {
+		while (next < order.size() && !(log.time[i] < maxTimes[order[next]]))
+			grids[order[next++]] = grid;
+		if (next == order.size())
+			return;
+		rasterize_snapshot(log, i, average_dt, cell, grid);
+	}
+	while (next < order.size())
+		grids[order[next++]] = grid;
+}
+
+Polyhedron* boids_polyhedron(const BoidsGrid& grid)
+{
+	int size = grid.size;
+	int cells = size - 1;
+	Polyhedron* poly = new Polyhedron(size * size, cells * cells);
+	float half = ((float)size - 1) / 2;
+
+	/* same vertex order as BoidPly. Note that grid row i (an x index) is
+	   written out at y = i; keep it that way so both loaders agree. */
+	int k = 0;
+	for (int i = size - 1; i >= 0; i--) {
+		for (int j = size - 1; j >= 0; j--) {
+			int g = i * size + j;
+			Vertex* v = poly->new_vertex((float)j - half, (float)i - half, 0.0);
+			v->vx = grid.path[g * 3 + 0];
+			v->vy = grid.path[g * 3 + 1];
+			v->vz = grid.path[g * 3 + 2];
+			v->scalar = grid.traffic[g];
+			poly->vlist[k++] = v;
+		}
+	}
+
+	/* faces go SE, SW, NW, NE without wrapping around the row ends */
+	k = 0;
+	for (int row = 0; row < cells; row++) {
+		for (int col = 0; col < cells; col++) {
+			int comb = row * size + col;
+			Quad* q = poly->new_quad();
+			q->verts[0] = poly->vlist[comb];
+			q->verts[1] = poly->vlist[comb + 1];
+			q->verts[2] = poly->vlist[comb + size + 1];
+			q->verts[3] = poly->vlist[comb + size];
+			q->other_props = NULL;
+			poly->qlist[k++] = q;
+		}
+	}
+
+	poly->grid = StructuredGrid::detect(poly);
+	return poly;
+}
+
+static void append_float(std::string& out, float value)
+{
+	char buffer[32];
+	std::to_chars_result r = std::to_chars(buffer, buffer + sizeof(buffer), value);
+	out.append(buffer, r.ptr);
+}
+
+static void append_int(std::string& out, int value)
+{
+	char buffer[16];
+	std::to_chars_result r = std::to_chars(buffer, buffer + sizeof(buffer), value);
+	out.append(buffer, r.ptr);
+}
+
+bool write_boids_ply(const BoidsGrid& grid, const char* path)
+{
+	int size = grid.size;
+	int cells = size - 1;
+	float half = ((float)size - 1) / 2;
+
+	std::string out;
+	out.reserve((size_t)size * size * 48 + (size_t)cells * cells * 24 + 512);
+
+	/* same header as BoidsExperiment.GeneratePlyHeader */
+	out += "ply\nformat ascii 1.0\ncomment created by learnply -slice\nelement vertex ";
+	append_int(out, size * size);
+	out += "\nproperty float64 x\nproperty float64 y\nproperty float64 z\n"
+		"property float64 vx\nproperty float64 vy\nproperty float64 vz\nproperty float64 s\n"
+		"element face ";
+	append_int(out, cells * cells);
+	out += "\nproperty list uint8 int32 vertex_indices\nend_header\n";
+
+	/* vertices and faces in the order of boids_polyhedron */
+	for (int i = size - 1; i >= 0; i--) {
+		for (int j = size - 1; j >= 0; j--) {
+			int g = i * size + j;
+			append_float(out, (float)j - half);
+			out += '\t';
+			append_float(out, (float)i - half);
+			out += "\t0.000000";
+			for (int k = 0; k < 3; k++) {
+				out += '\t';
+				append_float(out, grid.path[g * 3 + k]);
+			}
+			out += '\t';
+			append_float(out, grid.traffic[g]);
+			out += '\n';
+		}
+	}
+
+	for (int row = 0; row < cells; row++) {
+		for (int col = 0; col < cells; col++) {
+			int comb = row * size + col;
+			int index[4] = { comb, comb + 1, comb + size + 1, comb + size };
+			out += '4';
+			for (int k = 0; k < 4; k++) {
+				out += ' ';
+				append_int(out, index[k]);
+			}
+			out += '\n';
+		}
+	}
+
+	FILE* file = fopen(path, "wb");
+	if (file == NULL)
+		return false;
+	bool ok = fwrite(out.data(), 1, out.size(), file) == out.size();
+	return (fclose(file) == 0) && ok;
+}
+
+Polyhedron* load_boids(const char* path, int gridSize, float maxTime)
+{
+	BoidsLog log;
+	if (!read_boids_log(path, log))
+		return NULL;
+
+	BoidsGrid grid;
+	rasterize_boids(log, BOIDS_KNOWN_BOUNDS, gridSize, maxTime, grid);
+	return boids_polyhedron(grid);
+}
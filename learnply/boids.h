@@ -0,0 +1,88 @@
+/*
+
+Native reader for raw boids simulator logs
+
+Replaces the boidsTransformer round trip (raw log -> ASCII PLY -> load_ply)
+by rasterizing the log straight into a Polyhedron.
+
+*/
+
+#ifndef __BOIDS_H__
+#define __BOIDS_H__
+
+#include <math.h>
+#include <vector>
+
+class Polyhedron;
+
+/// <summary>
+/// Resolution used when a raw log is opened in the viewer. Matches the -s 65 used for the proc_boids_ts series.
+/// </summary>
+const int BOIDS_GRID_SIZE = 65;
+
+/// <summary>
+/// minX, minY, maxX, maxY of the simulation. This isn't supplied in the raw data file, same as Program.KNOWN_BOUNDS.
+/// </summary>
+const float BOIDS_KNOWN_BOUNDS[4] = { -1500.0f, -1500.0f, 1500.0f, 1500.0f };
+
+/// <summary>
+/// A whole boids simulation, stored by column. Snapshot i owns the boids [first[i], first[i + 1]) of x and y.
+/// </summary>
+struct BoidsLog {
+	std::vector<float> time;			/* timestamp of each snapshot */
+	std::vector<unsigned int> first;	/* offset of each snapshot's first boid, plus one past the end */
+	std::vector<float> x, y;			/* boid coordinates */
+
+	int snapshots() const { return (int)time.size(); }
+	int boids(int snapshot) const { return (int)(first[snapshot + 1] - first[snapshot]); }
+};
+
+/// <summary>
+/// Traffic and path grids of a rasterized log. All arrays are indexed [x index][y index] like ProjectBoidsToGrid.
+/// </summary>
+struct BoidsGrid {
+	int size;
+	float bounds[4];
+	std::vector<float> traffic;		/* size*size scalars */
+	std::vector<float> path;		/* size*size*3 vector components */
+	std::vector<float> weight;		/* size*size; number of vectors averaged into each vertex */
+};
+
+/// <summary>
+/// Reads a raw log of the form {timestamp}:{x_0};{y_0}#...{x_(n-1)};{y_(n-1)}#
+/// The file is memory mapped and split at line boundaries so large logs are parsed on all cores.
+/// </summary>
+/// <returns>False if the file can't be opened or a line can't be interpreted.</returns>
+bool read_boids_log(const char* path, BoidsLog& log);
+
+/// <summary>
+/// Projects the log onto a gridSize x gridSize grid with the SAME_QUAD mapping of BoidsExperiment.ProjectBoidsToGrid.
+/// Only snapshots taken before maxTime are included.
+/// </summary>
+void rasterize_boids(const BoidsLog& log, const float bounds[4], int gridSize, float maxTime, BoidsGrid& grid);
+
+/// <summary>
+/// Rasterizes the log once for a whole list of horizons; grids[h] is what rasterize_boids gives for maxTimes[h].
+/// A log sorted by time is read in a single pass, copying the grid out as each horizon is crossed.
+/// An unsorted log falls back to one pass per horizon. maxTimes must not contain NaN.
+/// </summary>
+void rasterize_boids(const BoidsLog& log, const float bounds[4], int gridSize, const std::vector<float>& maxTimes, std::vector<BoidsGrid>& grids);
+
+/// <summary>
+/// Builds the same mesh BoidsExperiment.BoidPly would have written out, without going through text.
+/// The result still needs Polyhedron::initialize().
+/// </summary>
+Polyhedron* boids_polyhedron(const BoidsGrid& grid);
+
+/// <summary>
+/// Writes the grid as the ASCII PLY BoidsExperiment.BoidPly would have, with floats in their shortest round-trip form.
+/// </summary>
+/// <returns>False if the file can't be written.</returns>
+bool write_boids_ply(const BoidsGrid& grid, const char* path);
+
+/// <summary>
+/// Convenience wrapper: read, rasterize and mesh a raw log. NULL if the log can't be read.
+/// </summary>
+Polyhedron* load_boids(const char* path, int gridSize = BOIDS_GRID_SIZE, float maxTime = INFINITY);
+
+#endif /* __BOIDS_H__ */
@@ -0,0 +1,44 @@
+/*
+
+Mapping the scalar field to vertex colors
+
+*/
+
+#include <string.h>
+#include "color_map.h"
+
+ColorMap::ColorMap(double lower, double upper, const float lower_color[3], const float upper_color[3])
+	: lower(lower), upper(upper)
+{
+	memcpy(this->lower_color, lower_color, sizeof(this->lower_color));
+	memcpy(this->upper_color, upper_color, sizeof(this->upper_color));
+}
+
+bool ColorMap::operator==(const ColorMap& other) const
+{
+	return lower == other.lower && upper == other.upper &&
+		memcmp(lower_color, other.lower_color, sizeof(lower_color)) == 0 &&
+		memcmp(upper_color, other.upper_color, sizeof(upper_color)) == 0;
+}
+
+static unsigned char to_byte(double c)
+{
+	if (!(c > 0))
+		return 0;
+	if (c >= 1)
+		return 255;
+	return (unsigned char)(c * 255 + 0.5);
+}
+
+void ColorMap::apply(const double* a, int n, std::vector<unsigned char>& rgba) const
+{
+	rgba.resize(4 * (size_t)n);
+	double range = upper - lower;
+	for (int i = 0; i < n; i++) {
+		double above = (a[i] - lower) / range, below = (upper - a[i]) / range;
+		unsigned char* c = &rgba[4 * (size_t)i];
+		for (int k = 0; k < 3; k++)
+			c[k] = to_byte(lower_color[k] * above + upper_color[k] * below);
+		c[3] = 255;
+	}
+}
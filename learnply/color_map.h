@@ -0,0 +1,38 @@
+/*
+
+Mapping the scalar field to vertex colors
+
+Coloring by scalar used to be worked out per quad vertex on every frame,
+although neither the field nor the colors change between frames. A
+ColorMap says how the field is colored; applying it gives packed RGBA8
+per vertex, which is kept until the map or the dataset changes.
+
+*/
+
+#ifndef __COLOR_MAP_H__
+#define __COLOR_MAP_H__
+
+#include <vector>
+
+/// <summary>
+/// Blends two colors over [lower, upper] of the scalar. Each channel of a value s is
+/// lower_color * (s - lower)/(upper - lower) + upper_color * (upper - s)/(upper - lower), clamped to [0, 1].
+/// </summary>
+struct ColorMap {
+	double lower = 0, upper = 1;
+	float lower_color[3] = { 0, 0, 0 };
+	float upper_color[3] = { 1, 1, 1 };
+
+	ColorMap() {}
+	ColorMap(double lower, double upper, const float lower_color[3], const float upper_color[3]);
+
+	bool operator==(const ColorMap& other) const;
+	bool operator!=(const ColorMap& other) const { return !(*this == other); }
+
+	/// <summary>
+	/// Colors a[0..n) into rgba, 4 bytes a vertex with alpha 255. Channels outside [0, 1] are clamped, as OpenGL would.
+	/// </summary>
+	void apply(const double* a, int n, std::vector<unsigned char>& rgba) const;
+};
+
+#endif /* __COLOR_MAP_H__ */
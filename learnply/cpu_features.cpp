@@ -0,0 +1,48 @@
+/*
+
+CPU features
+
+*/
+
+#include "cpu_features.h"
+
+#ifdef HAVE_X86
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+static bool detect_avx2()
+{
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return false;
+	__cpuid(info, 1);
+	/* the OS has to save the ymm registers too, not just the CPU support them */
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx = (info[2] & (1 << 28)) != 0;
+	if (!osxsave || !avx || (_xgetbv(0) & 6) != 6)
+		return false;
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+
+bool cpu_has_avx2()
+{
+	static const bool avx2 = detect_avx2();
+	return avx2;
+}
+
+#else
+
+bool cpu_has_avx2()
+{
+	return false;
+}
+
+#endif /* HAVE_X86 */
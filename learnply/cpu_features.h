@@ -0,0 +1,30 @@
+/*
+
+CPU features
+
+Which instruction sets the vectorized loops may use. HAVE_X86 is defined
+where the compiler can emit AVX2 at all, and AVX2_TARGET marks a function
+that uses it; cpu_has_avx2 says whether the machine running the build has
+it, so each loop picks its path at run time.
+
+*/
+
+#ifndef __CPU_FEATURES_H__
+#define __CPU_FEATURES_H__
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define HAVE_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#define AVX2_TARGET
+#else
+#define AVX2_TARGET __attribute__((target("avx2")))
+#endif
+#endif
+
+/// <summary>
+/// True if the CPU and the OS support AVX2. Decided once, so the same build runs on machines without it.
+/// </summary>
+bool cpu_has_avx2();
+
+#endif /* __CPU_FEATURES_H__ */
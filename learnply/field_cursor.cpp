@@ -0,0 +1,43 @@
+/*
+
+Sampling the vector field of a Polyhedron along a path
+
+*/
+
+#include "polyhedron.h"
+#include "point_locator.h"
+#include "field_cursor.h"
+
+FieldCursor::FieldCursor(Polyhedron* poly)
+{
+	this->poly = poly;
+	locator = poly->point_locator();
+	quad = -1;
+}
+
+bool FieldCursor::sample(double x, double y, icVector3* v)
+{
+	double s, t;
+	if (!locator->walk(x, y, &quad, &s, &t)) {
+		quad = -1;
+		return false;
+	}
+
+	/* bilinear weights of the corners
+	   [3] . . . [2]
+		.         .
+		t         .
+		.         .
+	   [0] . s . [1]
+	*/
+	Vertex** verts = poly->qlist[quad]->verts;
+	double p0 = (1 - s) * (1 - t);
+	double p1 = s * (1 - t);
+	double p2 = s * t;
+	double p3 = (1 - s) * t;
+
+	v->x = (p0 * verts[0]->vx) + (p1 * verts[1]->vx) + (p2 * verts[2]->vx) + (p3 * verts[3]->vx);
+	v->y = (p0 * verts[0]->vy) + (p1 * verts[1]->vy) + (p2 * verts[2]->vy) + (p3 * verts[3]->vy);
+	v->z = 0;
+	return true;
+}
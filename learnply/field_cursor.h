@@ -0,0 +1,45 @@
+/*
+
+Sampling the vector field of a Polyhedron along a path
+
+A particle moving through the field is nearly always in the quad it was in
+at its last sample, or one next to it. The cursor remembers that quad and
+walks from it to find the next one, so a sample costs the same however
+large the mesh is.
+
+*/
+
+#ifndef __FIELD_CURSOR_H__
+#define __FIELD_CURSOR_H__
+
+#include "icVector.H"
+
+class Polyhedron;
+class PointLocator;
+
+/// <summary>
+/// One path through the field of a Polyhedron. Cheap to make; use one per path, and one per thread.
+/// </summary>
+class FieldCursor {
+public:
+	int quad;		/* quad of the last sample, -1 before the first one or after leaving the mesh */
+
+	FieldCursor(Polyhedron* poly);
+
+	/// <summary>
+	/// Bilinearly interpolates the vector field at (x, y).
+	/// </summary>
+	/// <returns>False if (x, y) is outside the mesh; v is left alone.</returns>
+	bool sample(double x, double y, icVector3* v);
+
+	/// <summary>
+	/// Forgets the last quad, e.g. before starting a new path far from the old one.
+	/// </summary>
+	void reset() { quad = -1; }
+
+private:
+	Polyhedron* poly;
+	PointLocator* locator;
+};
+
+#endif /* __FIELD_CURSOR_H__ */
@@ -0,0 +1,183 @@
+/*
+
+Batched sampling of the vector field
+
+*/
+
+#include <math.h>
+#include "polyhedron.h"
+#include "structured_grid.h"
+#include "point_locator.h"
+#include "vertex_attributes.h"
+#include "field_sampler.h"
+#include "cpu_features.h"
+
+/******************************************************************************
+Everything the grid kernels need, flattened out of StructuredGrid. Cells
+are found like StructuredGrid::locate does, but multiplying by the inverse
+spacing rather than dividing, so s and t can differ from it in the last
+bit.
+******************************************************************************/
+
+struct GridKernel {
+	double origin[2];
+	double inverse_spacing[2];
+	double tolerance;		/* how far past the edge of the grid still counts, in cells */
+	int nx, ny;
+	const double* vx;
+	const double* vy;
+};
+
+static void sample_grid_scalar(const GridKernel& g, const double* x, const double* y, int n,
+	double* vx, double* vy, unsigned char* inside)
+{
+	double last_col = g.nx - 2, last_row = g.ny - 2;
+	for (int i = 0; i < n; i++) {
+		double fx = (x[i] - g.origin[0]) * g.inverse_spacing[0];
+		double fy = (y[i] - g.origin[1]) * g.inverse_spacing[1];
+		bool in = fx >= -g.tolerance && fx <= last_col + 1 + g.tolerance &&
+			fy >= -g.tolerance && fy <= last_row + 1 + g.tolerance;
+
+		/* fmax(NaN, 0) is 0, so even NaN lands on a real cell */
+		double col = fmin(fmax(floor(fx), 0.0), last_col);
+		double row = fmin(fmax(floor(fy), 0.0), last_row);
+		double s = fmin(fmax(fx - col, 0.0), 1.0);
+		double t = fmin(fmax(fy - row, 0.0), 1.0);
+
+		int k = (int)row * g.nx + (int)col;
+		double a = g.vx[k] + s * (g.vx[k + 1] - g.vx[k]);
+		double b = g.vx[k + g.nx] + s * (g.vx[k + g.nx + 1] - g.vx[k + g.nx]);
+		vx[i] = in ? a + t * (b - a) : 0;
+		a = g.vy[k] + s * (g.vy[k + 1] - g.vy[k]);
+		b = g.vy[k + g.nx] + s * (g.vy[k + g.nx + 1] - g.vy[k + g.nx]);
+		vy[i] = in ? a + t * (b - a) : 0;
+		if (inside)
+			inside[i] = in;
+	}
+}
+
+#ifdef HAVE_X86
+
+/******************************************************************************
+AVX2 version of the grid kernel: the same arithmetic in the same order,
+four points per iteration, with the corners fetched by gathers.
+******************************************************************************/
+
+AVX2_TARGET static void sample_grid_avx2(const GridKernel& g, const double* x, const double* y, int n,
+	double* vx, double* vy, unsigned char* inside)
+{
+	const __m256d ox = _mm256_set1_pd(g.origin[0]), oy = _mm256_set1_pd(g.origin[1]);
+	const __m256d isx = _mm256_set1_pd(g.inverse_spacing[0]), isy = _mm256_set1_pd(g.inverse_spacing[1]);
+	const __m256d low = _mm256_set1_pd(-g.tolerance);
+	const __m256d high_x = _mm256_set1_pd(g.nx - 1 + g.tolerance), high_y = _mm256_set1_pd(g.ny - 1 + g.tolerance);
+	const __m256d last_col = _mm256_set1_pd(g.nx - 2), last_row = _mm256_set1_pd(g.ny - 2);
+	const __m256d zero = _mm256_setzero_pd(), one = _mm256_set1_pd(1.0);
+	const __m128i row_length = _mm_set1_epi32(g.nx), one_i = _mm_set1_epi32(1);
+
+	int i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m256d fx = _mm256_mul_pd(_mm256_sub_pd(_mm256_loadu_pd(x + i), ox), isx);
+		__m256d fy = _mm256_mul_pd(_mm256_sub_pd(_mm256_loadu_pd(y + i), oy), isy);
+		__m256d in = _mm256_and_pd(
+			_mm256_and_pd(_mm256_cmp_pd(fx, low, _CMP_GE_OQ), _mm256_cmp_pd(fx, high_x, _CMP_LE_OQ)),
+			_mm256_and_pd(_mm256_cmp_pd(fy, low, _CMP_GE_OQ), _mm256_cmp_pd(fy, high_y, _CMP_LE_OQ)));
+
+		/* max_pd returns its second operand when the first is NaN, same as fmax above */
+		__m256d col = _mm256_min_pd(_mm256_max_pd(_mm256_floor_pd(fx), zero), last_col);
+		__m256d row = _mm256_min_pd(_mm256_max_pd(_mm256_floor_pd(fy), zero), last_row);
+		__m256d s = _mm256_min_pd(_mm256_max_pd(_mm256_sub_pd(fx, col), zero), one);
+		__m256d t = _mm256_min_pd(_mm256_max_pd(_mm256_sub_pd(fy, row), zero), one);
+
+		__m128i k0 = _mm_add_epi32(_mm_mullo_epi32(_mm256_cvttpd_epi32(row), row_length), _mm256_cvttpd_epi32(col));
+		__m128i k1 = _mm_add_epi32(k0, one_i);
+		__m128i k3 = _mm_add_epi32(k0, row_length);
+		__m128i k2 = _mm_add_epi32(k3, one_i);
+
+		__m256d v0 = _mm256_i32gather_pd(g.vx, k0, 8), v1 = _mm256_i32gather_pd(g.vx, k1, 8);
+		__m256d v2 = _mm256_i32gather_pd(g.vx, k2, 8), v3 = _mm256_i32gather_pd(g.vx, k3, 8);
+		__m256d a = _mm256_add_pd(v0, _mm256_mul_pd(s, _mm256_sub_pd(v1, v0)));
+		__m256d b = _mm256_add_pd(v3, _mm256_mul_pd(s, _mm256_sub_pd(v2, v3)));
+		_mm256_storeu_pd(vx + i, _mm256_and_pd(_mm256_add_pd(a, _mm256_mul_pd(t, _mm256_sub_pd(b, a))), in));
+
+		v0 = _mm256_i32gather_pd(g.vy, k0, 8);
+		v1 = _mm256_i32gather_pd(g.vy, k1, 8);
+		v2 = _mm256_i32gather_pd(g.vy, k2, 8);
+		v3 = _mm256_i32gather_pd(g.vy, k3, 8);
+		a = _mm256_add_pd(v0, _mm256_mul_pd(s, _mm256_sub_pd(v1, v0)));
+		b = _mm256_add_pd(v3, _mm256_mul_pd(s, _mm256_sub_pd(v2, v3)));
+		_mm256_storeu_pd(vy + i, _mm256_and_pd(_mm256_add_pd(a, _mm256_mul_pd(t, _mm256_sub_pd(b, a))), in));
+
+		if (inside) {
+			int mask = _mm256_movemask_pd(in);
+			inside[i] = mask & 1;
+			inside[i + 1] = (mask >> 1) & 1;
+			inside[i + 2] = (mask >> 2) & 1;
+			inside[i + 3] = (mask >> 3) & 1;
+		}
+	}
+
+	if (i < n)
+		sample_grid_scalar(g, x + i, y + i, n - i, vx + i, vy + i, inside ? inside + i : 0);
+}
+
+#endif /* HAVE_X86 */
+
+FieldSampler::FieldSampler(Polyhedron* poly)
+{
+	this->poly = poly;
+	/* built on first use otherwise, which isn't safe once several threads share the sampler */
+	if (!poly->grid)
+		poly->point_locator();
+}
+
+void FieldSampler::sample(const double* x, const double* y, int n, double* vx, double* vy, unsigned char* inside) const
+{
+	const VertexAttributes& attr = poly->attributes;
+
+	if (poly->grid) {
+		const StructuredGrid* grid = poly->grid;
+		GridKernel g;
+		g.origin[0] = grid->origin[0];
+		g.origin[1] = grid->origin[1];
+		g.inverse_spacing[0] = 1.0 / grid->spacing[0];
+		g.inverse_spacing[1] = 1.0 / grid->spacing[1];
+		g.tolerance = 1.0e-9 * (grid->nx + grid->ny);
+		g.nx = grid->nx;
+		g.ny = grid->ny;
+		g.vx = attr.vx.data();
+		g.vy = attr.vy.data();
+#ifdef HAVE_X86
+		if (cpu_has_avx2()) {
+			sample_grid_avx2(g, x, y, n, vx, vy, inside);
+			return;
+		}
+#endif
+		sample_grid_scalar(g, x, y, n, vx, vy, inside);
+		return;
+	}
+
+	/* any other mesh: one point at a time, but walking from the last point's quad since batches tend to be coherent */
+	const PointLocator* locator = poly->locator;
+	int quad = -1;
+	for (int i = 0; i < n; i++) {
+		double s, t;
+		if (!locator->walk(x[i], y[i], &quad, &s, &t)) {
+			quad = -1;
+			vx[i] = vy[i] = 0;
+			if (inside)
+				inside[i] = 0;
+			continue;
+		}
+
+		Vertex** verts = poly->qlist[quad]->verts;
+		int k0 = verts[0]->index, k1 = verts[1]->index, k2 = verts[2]->index, k3 = verts[3]->index;
+		double a = attr.vx[k0] + s * (attr.vx[k1] - attr.vx[k0]);
+		double b = attr.vx[k3] + s * (attr.vx[k2] - attr.vx[k3]);
+		vx[i] = a + t * (b - a);
+		a = attr.vy[k0] + s * (attr.vy[k1] - attr.vy[k0]);
+		b = attr.vy[k3] + s * (attr.vy[k2] - attr.vy[k3]);
+		vy[i] = a + t * (b - a);
+		if (inside)
+			inside[i] = 1;
+	}
+}
@@ -0,0 +1,36 @@
+/*
+
+Batched sampling of the vector field
+
+FieldCursor answers one point at a time through Vertex pointers. The
+sampler takes whole arrays of points and reads the vector field from the
+structure-of-arrays store instead; on structured grids the cell lookup and
+bilinear blend run four points at a time with AVX2 where the CPU has it.
+Particle methods that move many points per step (LIC, IBFV) sample here.
+
+*/
+
+#ifndef __FIELD_SAMPLER_H__
+#define __FIELD_SAMPLER_H__
+
+class Polyhedron;
+
+/// <summary>
+/// Samples the vector field of an initialized Polyhedron. Holds no per-call state, so one sampler can be shared by any number of threads.
+/// The Polyhedron's attributes must be current (see VertexAttributes::gather).
+/// </summary>
+class FieldSampler {
+public:
+	FieldSampler(Polyhedron* poly);
+
+	/// <summary>
+	/// Bilinearly interpolates the field at (x[i], y[i]) into (vx[i], vy[i]) for i in [0, n).
+	/// Points outside the mesh get a zero vector and, if inside is given, inside[i] = 0; the others get inside[i] = 1.
+	/// </summary>
+	void sample(const double* x, const double* y, int n, double* vx, double* vy, unsigned char* inside = 0) const;
+
+private:
+	Polyhedron* poly;
+};
+
+#endif /* __FIELD_SAMPLER_H__ */
@@ -0,0 +1,237 @@
+/*
+
+Instanced drawing of arrow glyphs
+
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <stddef.h>
+#include "polyline.h"
+#include "glyph_renderer.h"
+
+/* generic attribute of each input of the shader */
+enum { CORNER, TAIL, DIRECTION, COLOR };
+
+/* the arrow, from tail to tip and then the two strokes of the head from the tip back:
+   x is how far along the arrow, y and z how much of the head's back and aside lengths */
+static const float arrow_template[6][3] = {
+	{ 0, 0, 0 }, { 1, 0, 0 },
+	{ 1, 0, 0 }, { 1, 1, 1 },
+	{ 1, 0, 0 }, { 1, 1, -1 },
+};
+
+/* only a vertex shader, so the lines are smoothed and blended as any others */
+static const char* vertex_shader =
+	"#version 120\n"
+	"uniform vec3 head;\n"
+	"attribute vec3 corner;\n"
+	"attribute vec4 tail;\n"
+	"attribute vec3 direction;\n"
+	"attribute vec4 color;\n"
+	"void main()\n"
+	"{\n"
+	"	vec3 p = tail.xyz + direction * (tail.w * corner.x);\n"
+	"	if (tail.w > head.z) {\n"
+	"		vec2 u = normalize(direction.xy);\n"
+	"		p.xy += u * (corner.y * head.x) + vec2(-u.y, u.x) * (corner.z * head.y);\n"
+	"	}\n"
+	"	gl_Position = gl_ModelViewProjectionMatrix * vec4(p, 1.0);\n"
+	"	gl_FrontColor = color;\n"
+	"}\n";
+
+GlyphRenderer::GlyphRenderer()
+	: checked(false), instanced(false), use_buffers(false), uploaded(false), program(0), head_location(-1)
+{
+	memset(head, 0, sizeof(head));
+	memset(buffers, 0, sizeof(buffers));
+}
+
+static unsigned char to_byte(float c)
+{
+	return c <= 0 ? 0 : c >= 1 ? 255 : (unsigned char)(c * 255 + 0.5f);
+}
+
+void GlyphRenderer::set_glyphs(const LineSegment* segments, int count)
+{
+	unsigned char color[4] = { to_byte(style.color[0]), to_byte(style.color[1]), to_byte(style.color[2]), 255 };
+
+	instances.resize(count);
+	for (int i = 0; i < count; i++) {
+		const LineSegment& s = segments[i];
+		GlyphInstance& g = instances[i];
+		double len = s.len > 0 ? s.len : 1;
+		for (int k = 0; k < 3; k++) {
+			g.position[k] = (float)s.start.entry[k];
+			g.direction[k] = (float)((s.end.entry[k] - s.start.entry[k]) / len);
+		}
+		g.length = (float)s.len;
+		memcpy(g.color, color, sizeof(g.color));
+	}
+
+	head[0] = -cosf(style.head_angle) * style.head_length;
+	head[1] = sinf(style.head_angle) * style.head_length;
+	head[2] = style.head_min_length;
+	lines.clear();
+	uploaded = false;
+}
+
+bool GlyphRenderer::make_program()
+{
+	GLuint shader = glCreateShader(GL_VERTEX_SHADER);
+	glShaderSource(shader, 1, &vertex_shader, NULL);
+	glCompileShader(shader);
+
+	program = glCreateProgram();
+	glAttachShader(program, shader);
+	glBindAttribLocation(program, CORNER, "corner");
+	glBindAttribLocation(program, TAIL, "tail");
+	glBindAttribLocation(program, DIRECTION, "direction");
+	glBindAttribLocation(program, COLOR, "color");
+	glLinkProgram(program);
+	glDeleteShader(shader);
+
+	GLint linked = 0;
+	glGetProgramiv(program, GL_LINK_STATUS, &linked);
+	if (!linked) {
+		char log[1024] = "";
+		glGetProgramInfoLog(program, sizeof(log), NULL, log);
+		fprintf(stderr, "Arrow shader failed, drawing arrows as lines: %s\n", log);
+		glDeleteProgram(program);
+		program = 0;
+		return false;
+	}
+	head_location = glGetUniformLocation(program, "head");
+	return true;
+}
+
+/******************************************************************************
+The same arrows the shader makes, for contexts that can't instance: a shaft
+and the two strokes of the head, as GL_LINES.
+******************************************************************************/
+void GlyphRenderer::expand_lines()
+{
+	lines.resize(18 * instances.size());
+	line_colors.resize(24 * instances.size());
+	for (size_t i = 0; i < instances.size(); i++) {
+		const GlyphInstance& g = instances[i];
+		float* v = &lines[18 * i];
+		for (int j = 0; j < 6; j++) {
+			const float* c = arrow_template[j];
+			for (int k = 0; k < 3; k++)
+				v[3 * j + k] = g.position[k] + g.direction[k] * g.length * c[0];
+			if (g.length > head[2]) {
+				float n = sqrtf(g.direction[0] * g.direction[0] + g.direction[1] * g.direction[1]);
+				float ux = n > 0 ? g.direction[0] / n : 0, uy = n > 0 ? g.direction[1] / n : 0;
+				v[3 * j] += ux * c[1] * head[0] - uy * c[2] * head[1];
+				v[3 * j + 1] += uy * c[1] * head[0] + ux * c[2] * head[1];
+			}
+			memcpy(&line_colors[24 * i + 4 * j], g.color, 4);
+		}
+	}
+}
+
+void GlyphRenderer::upload()
+{
+	if (!checked) {
+		checked = true;
+		use_buffers = GLEW_VERSION_1_5 != 0;
+		instanced = GLEW_VERSION_3_3 && make_program();
+		if (use_buffers)
+			glGenBuffers(SLOTS, buffers);
+		if (instanced) {
+			glBindBuffer(GL_ARRAY_BUFFER, buffers[TEMPLATE]);
+			glBufferData(GL_ARRAY_BUFFER, sizeof(arrow_template), arrow_template, GL_STATIC_DRAW);
+		}
+	}
+
+	if (instanced) {
+		glBindBuffer(GL_ARRAY_BUFFER, buffers[INSTANCES]);
+		glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(GlyphInstance), instances.data(), GL_STATIC_DRAW);
+	}
+	else {
+		expand_lines();
+		if (use_buffers) {
+			/* positions, then the colors */
+			size_t bytes = lines.size() * sizeof(float);
+			glBindBuffer(GL_ARRAY_BUFFER, buffers[LINES]);
+			glBufferData(GL_ARRAY_BUFFER, bytes + line_colors.size(), NULL, GL_STATIC_DRAW);
+			glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, lines.data());
+			glBufferSubData(GL_ARRAY_BUFFER, bytes, line_colors.size(), line_colors.data());
+		}
+	}
+	if (use_buffers)
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	uploaded = true;
+}
+
+void GlyphRenderer::draw()
+{
+	if (instances.empty())
+		return;
+	if (!uploaded)
+		upload();
+
+	glDisable(GL_LIGHTING);
+	glEnable(GL_LINE_SMOOTH);
+	glHint(GL_LINE_SMOOTH_HINT, GL_NICEST);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glLineWidth(style.width);
+
+	if (instanced) {
+		glUseProgram(program);
+		glUniform3fv(head_location, 1, head);
+
+		glBindBuffer(GL_ARRAY_BUFFER, buffers[TEMPLATE]);
+		glEnableVertexAttribArray(CORNER);
+		glVertexAttribPointer(CORNER, 3, GL_FLOAT, GL_FALSE, 0, 0);
+
+		glBindBuffer(GL_ARRAY_BUFFER, buffers[INSTANCES]);
+		GLsizei stride = sizeof(GlyphInstance);
+		glVertexAttribPointer(TAIL, 4, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(GlyphInstance, position));
+		glVertexAttribPointer(DIRECTION, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(GlyphInstance, direction));
+		glVertexAttribPointer(COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (void*)offsetof(GlyphInstance, color));
+		for (int a = TAIL; a <= COLOR; a++) {
+			glEnableVertexAttribArray(a);
+			glVertexAttribDivisor(a, 1);
+		}
+
+		glDrawArraysInstanced(GL_LINES, 0, 6, (GLsizei)instances.size());
+
+		for (int a = CORNER; a <= COLOR; a++) {
+			glVertexAttribDivisor(a, 0);
+			glDisableVertexAttribArray(a);
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		glUseProgram(0);
+	}
+	else {
+		const char* base = NULL;
+		if (use_buffers)
+			glBindBuffer(GL_ARRAY_BUFFER, buffers[LINES]);
+		glEnableClientState(GL_VERTEX_ARRAY);
+		glEnableClientState(GL_COLOR_ARRAY);
+		glVertexPointer(3, GL_FLOAT, 0, use_buffers ? base : (const char*)lines.data());
+		glColorPointer(4, GL_UNSIGNED_BYTE, 0, use_buffers ? base + lines.size() * sizeof(float) : (const char*)line_colors.data());
+		glDrawArrays(GL_LINES, 0, (GLsizei)(6 * instances.size()));
+		glDisableClientState(GL_COLOR_ARRAY);
+		glDisableClientState(GL_VERTEX_ARRAY);
+		if (use_buffers)
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	glDisable(GL_BLEND);
+}
+
+void GlyphRenderer::release()
+{
+	if (buffers[0] != 0)
+		glDeleteBuffers(SLOTS, buffers);
+	memset(buffers, 0, sizeof(buffers));
+	if (program != 0)
+		glDeleteProgram(program);
+	program = 0;
+	checked = instanced = uploaded = false;
+}
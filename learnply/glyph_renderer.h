@@ -0,0 +1,93 @@
+/*
+
+Instanced drawing of arrow glyphs
+
+Every arrow of a vector field is the same few lines: a shaft and two
+strokes of a head. Each arrow is kept as one instance (where it starts,
+which way it points, how long it is, its color), made once when the
+vectors are gathered, and the whole field is drawn with one instanced
+call over a shared arrow template, so the head no longer costs an atan,
+a cos and a sin per arrow per frame. Without OpenGL 3.3 the arrows are
+expanded into one array of lines instead, once per set of vectors.
+
+*/
+
+#ifndef __GLYPH_RENDERER_H__
+#define __GLYPH_RENDERER_H__
+
+#include <vector>
+#include "gl/glew.h"
+
+class LineSegment;
+
+/// <summary>
+/// One arrow, as the vertex shader reads it. 32 bytes.
+/// </summary>
+struct GlyphInstance {
+	float position[3];		/* tail of the arrow */
+	float length;
+	float direction[3];		/* unit */
+	unsigned char color[4];	/* RGBA8 */
+};
+
+/// <summary>
+/// How arrows look. Lengths are in model units; a change takes effect at the next set_glyphs.
+/// </summary>
+struct GlyphStyle {
+	float head_length = 0.15f;
+	float head_angle = 0.785398f;	/* between the shaft and each stroke of the head */
+	float head_min_length = 0.0f;	/* arrows no longer than this get no head */
+	float color[3] = { 1, 1, 1 };
+	float width = 1.0f;				/* of the lines, in pixels */
+};
+
+class GlyphRenderer {
+public:
+	GlyphRenderer();
+
+	GlyphStyle style;
+
+	/// <summary>
+	/// Makes one arrow per segment, from its start to its end, replacing the arrows there were.
+	/// Heads lie in the xy plane, as the meshes do.
+	/// </summary>
+	void set_glyphs(const LineSegment* segments, int count);
+
+	/// <summary>
+	/// Draws every arrow in one call, uploading them first if they changed since the last draw.
+	/// </summary>
+	void draw();
+
+	/// <summary>
+	/// Frees the program and the buffer objects. Needs the OpenGL context they were made in.
+	/// </summary>
+	void release();
+
+	int count() const { return (int)instances.size(); }
+
+private:
+	GlyphRenderer(const GlyphRenderer&);
+	GlyphRenderer& operator=(const GlyphRenderer&);
+
+	bool make_program();
+	void upload();
+	void expand_lines();
+
+	enum { TEMPLATE, INSTANCES, LINES, SLOTS };
+
+	std::vector<GlyphInstance> instances;
+	float head[3];			/* style at set_glyphs: how far each head stroke goes back and aside, and head_min_length */
+
+	bool checked;			/* whether the context was asked for instancing yet */
+	bool instanced;
+	bool use_buffers;
+	bool uploaded;
+	GLuint program;
+	GLint head_location;
+	GLuint buffers[SLOTS];
+
+	std::vector<float> lines;	/* without instancing: 6 vertices of 3 floats per arrow */
+	std::vector<unsigned char> line_colors;
+};
+
+#endif /* __GLYPH_RENDERER_H__ */
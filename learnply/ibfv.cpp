@@ -0,0 +1,385 @@
+/*
+
+Image Based Flow Visualization on the CPU
+
+*/
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+#include "polyhedron.h"
+#include "vertex_attributes.h"
+#include "ibfv.h"
+#include "noise_hash.h"
+#include "cpu_features.h"
+
+IbfvEngine::IbfvEngine()
+	: w(0), h(0), iframe(0), view_poly(NULL), tile(0)
+{
+	memset(view_matrix, 0, sizeof(view_matrix));
+	memset(view_port, 0, sizeof(view_port));
+}
+
+int ibfv_noise_tile(const IbfvOptions& options)
+{
+	int n = options.pattern_size > 0 ? options.pattern_size : 1;
+	double scale = options.scale > 0 ? options.scale : 1;
+	int tile = (int)(n * scale + 0.5);
+	return tile > 1 ? tile : 1;
+}
+
+/******************************************************************************
+The noise patterns, as makePatterns built them for OpenGL: every texel
+switches between black and white once per cycle of patterns at its own
+random phase. Each pattern comes already magnified to screen pixels,
+bilinear and wrapping like the GL_LINEAR, GL_REPEAT texture was.
+******************************************************************************/
+void ibfv_noise(const IbfvOptions& options, int k, std::vector<unsigned char>& pattern)
+{
+	int n = options.pattern_size > 0 ? options.pattern_size : 1;
+	int npat = options.patterns > 0 ? options.patterns : 1;
+	double scale = options.scale > 0 ? options.scale : 1;
+	int tile = ibfv_noise_tile(options);
+
+	int t = k * 256 / npat;
+	std::vector<unsigned char> texels(n * n);
+	for (int i = 0; i < n * n; i++)
+		texels[i] = (t + noise_hash(options.noise_seed, i) % 256) % 255 < 127 ? 0 : 255;
+
+	/* which texels each screen pixel of a tile falls between, the same for rows and columns */
+	std::vector<int> first(tile), second(tile);
+	std::vector<double> frac(tile);
+	for (int x = 0; x < tile; x++) {
+		double u = (x + 0.5) / scale - 0.5;
+		int i0 = (int)floor(u);
+		frac[x] = u - i0;
+		first[x] = ((i0 % n) + n) % n;
+		second[x] = (first[x] + 1) % n;
+	}
+
+	pattern.resize((size_t)tile * tile);
+	for (int y = 0; y < tile; y++) {
+		const unsigned char* r0 = &texels[first[y] * n];
+		const unsigned char* r1 = &texels[second[y] * n];
+		double fy = frac[y];
+		for (int x = 0; x < tile; x++) {
+			int c0 = first[x], c1 = second[x];
+			double a = r0[c0] + frac[x] * (r0[c1] - r0[c0]);
+			double b = r1[c0] + frac[x] * (r1[c1] - r1[c0]);
+			pattern[y * tile + x] = (unsigned char)(a + fy * (b - a) + 0.5);
+		}
+	}
+}
+
+void IbfvEngine::make_patterns()
+{
+	int npat = options.patterns > 0 ? options.patterns : 1;
+	tile = ibfv_noise_tile(options);
+
+	noise.resize((size_t)npat * tile * tile);
+	std::vector<unsigned char> pattern;
+	for (int k = 0; k < npat; k++) {
+		ibfv_noise(options, k, pattern);
+		memcpy(&noise[(size_t)k * tile * tile], pattern.data(), pattern.size());
+	}
+}
+
+void IbfvEngine::invalidate()
+{
+	view_poly = NULL;
+	tile = 0;
+}
+
+/* window coordinates of (x, y, z) relative to the viewport, as gluProject computes them */
+static bool project(const double* m, const double* p, const int* viewport, double x, double y, double z,
+	double* wx, double* wy)
+{
+	double e[4];
+	for (int i = 0; i < 4; i++)
+		e[i] = m[i] * x + m[4 + i] * y + m[8 + i] * z + m[12 + i];
+	double c[4];
+	for (int i = 0; i < 4; i++)
+		c[i] = p[i] * e[0] + p[4 + i] * e[1] + p[8 + i] * e[2] + p[12 + i] * e[3];
+	if (c[3] == 0)
+		return false;
+	*wx = (c[0] / c[3] + 1) * 0.5 * viewport[2];
+	*wy = (c[1] / c[3] + 1) * 0.5 * viewport[3];
+	return true;
+}
+
+/******************************************************************************
+Builds the warp table the first OpenGL pass stood for. Every vertex gets
+its window position pushed options.scale pixels along the field, as the
+texture coordinate of the warp, and the quads are rasterized with that
+interpolated across them (two triangles each, as GL_QUADS draws them).
+A pixel then reads the last frame where its warped coordinate points.
+******************************************************************************/
+void IbfvEngine::build_table(Polyhedron* poly, const double modelview[16], const double projection[16])
+{
+	const VertexAttributes& attr = poly->attributes;
+	int nverts = attr.size();
+	std::vector<double> px(nverts), py(nverts), tx(nverts), ty(nverts);
+	std::vector<unsigned char> visible(nverts);
+
+	/* the original normalized displacement, dmax = scale / width in both directions */
+	double dmax = options.scale / w;
+	for (int i = 0; i < nverts; i++) {
+		visible[i] = project(modelview, projection, view_port, attr.x[i], attr.y[i], attr.z[i], &px[i], &py[i]);
+		double dx = attr.vx[i], dy = attr.vy[i];
+		double len = sqrt(dx * dx + dy * dy);
+		dx = len > 0 ? dx / len * dmax : 0;
+		dy = len > 0 ? dy / len * dmax : 0;
+		tx[i] = px[i] + dx * w;
+		ty[i] = py[i] + dy * h;
+	}
+
+	/* pixels no quad covers read the white past the end of the frame */
+	source.assign((size_t)w * h, w * h);
+	weights.assign((size_t)w * h, 0);
+
+	static const int corner[2][3] = { { 0, 1, 2 }, { 0, 2, 3 } };
+	for (int q = 0; q < poly->nquads; q++) {
+		Quad* quad = poly->qlist[q];
+		for (int half = 0; half < 2; half++) {
+			int v[3];
+			bool ok = true;
+			for (int k = 0; k < 3; k++) {
+				v[k] = quad->verts[corner[half][k]]->index;
+				ok = ok && visible[v[k]];
+			}
+			if (!ok)
+				continue;
+
+			double x0 = px[v[0]], y0 = py[v[0]], x1 = px[v[1]], y1 = py[v[1]], x2 = px[v[2]], y2 = py[v[2]];
+			double area = (x1 - x0) * (y2 - y0) - (x2 - x0) * (y1 - y0);
+			if (fabs(area) < 1e-12)
+				continue;
+
+			int left = (int)floor(fmin(x0, fmin(x1, x2))), right = (int)ceil(fmax(x0, fmax(x1, x2)));
+			int bottom = (int)floor(fmin(y0, fmin(y1, y2))), top = (int)ceil(fmax(y0, fmax(y1, y2)));
+			left = left > 0 ? left : 0;
+			bottom = bottom > 0 ? bottom : 0;
+			right = right < w - 1 ? right : w - 1;
+			top = top < h - 1 ? top : h - 1;
+			if (left > right || bottom > top)
+				continue;
+
+			/* barycentric coordinates and the warped coordinate are all planes over the screen, so
+			   each moves by a constant from one pixel to the next */
+			double b0x = (y1 - y2) / area, b0y = (x2 - x1) / area, b0c = (x1 * y2 - x2 * y1) / area;
+			double b1x = (y2 - y0) / area, b1y = (x0 - x2) / area, b1c = (x2 * y0 - x0 * y2) / area;
+			double ux = b0x * tx[v[0]] + b1x * tx[v[1]] - (b0x + b1x) * tx[v[2]];
+			double uy = b0y * tx[v[0]] + b1y * tx[v[1]] - (b0y + b1y) * tx[v[2]];
+			double uc = b0c * tx[v[0]] + b1c * tx[v[1]] + (1 - b0c - b1c) * tx[v[2]];
+			double vx = b0x * ty[v[0]] + b1x * ty[v[1]] - (b0x + b1x) * ty[v[2]];
+			double vy = b0y * ty[v[0]] + b1y * ty[v[1]] - (b0y + b1y) * ty[v[2]];
+			double vc = b0c * ty[v[0]] + b1c * ty[v[1]] + (1 - b0c - b1c) * ty[v[2]];
+
+			/* pixel centers inside the triangle, edges included */
+			const double eps = -1e-9;
+			for (int j = bottom; j <= top; j++) {
+				double cx = left + 0.5, cy = j + 0.5;
+				double b0 = b0x * cx + b0y * cy + b0c;
+				double b1 = b1x * cx + b1y * cy + b1c;
+				double u = ux * cx + uy * cy + uc;
+				double v = vx * cx + vy * cy + vc;
+				for (int i = left; i <= right; i++, b0 += b0x, b1 += b1x, u += ux, v += vx) {
+					if (b0 < eps || b1 < eps || 1 - b0 - b1 < eps)
+						continue;
+
+					/* texel centers sit at half pixels; reads clamp to the edge of the frame */
+					double su = u - 0.5 > 0 ? u - 0.5 : 0, sv = v - 0.5 > 0 ? v - 0.5 : 0;
+					su = su < w - 1 ? su : w - 1;
+					sv = sv < h - 1 ? sv : h - 1;
+					int si = (int)su < w - 2 ? (int)su : w - 2;
+					int sj = (int)sv < h - 2 ? (int)sv : h - 2;
+					int fx = (int)((su - si) * 256 + 0.5), fy = (int)((sv - sj) * 256 + 0.5);
+					size_t p = (size_t)j * w + i;
+					source[p] = sj * w + si;
+					weights[p] = fx | (fy << 16);
+				}
+			}
+		}
+	}
+}
+
+bool IbfvEngine::set_view(Polyhedron* poly, const double modelview[16], const double projection[16], const int viewport[4])
+{
+	if (viewport[2] < 2 || viewport[3] < 2)
+		return false;
+	if (tile == 0)
+		make_patterns();
+
+	if (poly == view_poly && memcmp(view_matrix, modelview, 16 * sizeof(double)) == 0 &&
+		memcmp(view_matrix + 16, projection, 16 * sizeof(double)) == 0 &&
+		memcmp(view_port, viewport, sizeof(view_port)) == 0)
+		return false;
+
+	if (viewport[2] != w || viewport[3] != h) {
+		w = viewport[2];
+		h = viewport[3];
+		frame.assign((size_t)w * h + w + 4, 255);
+		scratch.assign(frame.size(), 255);
+		iframe = 0;
+	}
+	view_poly = poly;
+	memcpy(view_matrix, modelview, 16 * sizeof(double));
+	memcpy(view_matrix + 16, projection, 16 * sizeof(double));
+	memcpy(view_port, viewport, sizeof(view_port));
+
+	build_table(poly, modelview, projection);
+	return true;
+}
+
+/******************************************************************************
+One frame for a band of rows: bilinear read of the last frame through the
+table, then the noise blended over it, in 8-bit fixed point. Pixels off
+the mesh stay white, as the second OpenGL pass left them. The AVX2
+version does exactly the same integer arithmetic eight pixels at a time.
+******************************************************************************/
+
+struct IbfvBand {
+	const int* source;
+	const int* weights;
+	const unsigned char* last;
+	unsigned char* next;
+	const unsigned char* pattern;	/* this frame's noise tile */
+	int tile;
+	int width;
+	int alpha;						/* out of 256 */
+	int blank;						/* source of pixels off the mesh */
+	int row0, row1;
+};
+
+static inline unsigned char warp_pixel(const IbfvBand& b, size_t p, int noise)
+{
+	if (b.source[p] == b.blank)
+		return 255;
+	const unsigned char* s = b.last + b.source[p];
+	int fx = b.weights[p] & 0xffff, fy = b.weights[p] >> 16;
+	int top = s[0] * (256 - fx) + s[1] * fx;
+	int bottom = s[b.width] * (256 - fx) + s[b.width + 1] * fx;
+	int v = (top * (256 - fy) + bottom * fy + 32768) >> 16;
+	return (unsigned char)((v * (256 - b.alpha) + noise * b.alpha + 128) >> 8);
+}
+
+static void warp_band_scalar(const IbfvBand& b)
+{
+	for (int y = b.row0; y < b.row1; y++) {
+		const unsigned char* noise = b.pattern + (y % b.tile) * b.tile;
+		size_t row = (size_t)y * b.width;
+		for (int x = 0; x < b.width; x++)
+			b.next[row + x] = warp_pixel(b, row + x, noise[x % b.tile]);
+	}
+}
+
+#ifdef HAVE_X86
+
+AVX2_TARGET static void warp_band_avx2(const IbfvBand& b)
+{
+	const __m256i low = _mm256_set1_epi32(0xff);
+	const __m256i full = _mm256_set1_epi32(256);
+	const __m256i alpha = _mm256_set1_epi32(b.alpha), rest = _mm256_set1_epi32(256 - b.alpha);
+	const __m256i half = _mm256_set1_epi32(32768), round = _mm256_set1_epi32(128);
+	const __m256i blank = _mm256_set1_epi32(b.blank), white = _mm256_set1_epi32(255);
+	const int* base = (const int*)b.last;
+	const int* below = (const int*)(b.last + b.width);
+
+	for (int y = b.row0; y < b.row1; y++) {
+		const unsigned char* noise = b.pattern + (y % b.tile) * b.tile;
+		size_t row = (size_t)y * b.width;
+		int x = 0;
+		for (; x + 8 <= b.width; x += 8) {
+			int nx = x % b.tile;
+			if (nx + 8 > b.tile) {
+				for (int k = 0; k < 8; k++)
+					b.next[row + x + k] = warp_pixel(b, row + x + k, noise[(x + k) % b.tile]);
+				continue;
+			}
+			size_t p = row + x;
+			__m256i src = _mm256_loadu_si256((const __m256i*)(b.source + p));
+			__m256i wt = _mm256_loadu_si256((const __m256i*)(b.weights + p));
+			/* four bytes from each read, of which the first two are the texels side by side */
+			__m256i t = _mm256_i32gather_epi32(base, src, 1);
+			__m256i d = _mm256_i32gather_epi32(below, src, 1);
+			__m256i fx = _mm256_and_si256(wt, _mm256_set1_epi32(0xffff));
+			__m256i fy = _mm256_srli_epi32(wt, 16);
+			__m256i gx = _mm256_sub_epi32(full, fx), gy = _mm256_sub_epi32(full, fy);
+
+			__m256i top = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_and_si256(t, low), gx),
+				_mm256_mullo_epi32(_mm256_and_si256(_mm256_srli_epi32(t, 8), low), fx));
+			__m256i bottom = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_and_si256(d, low), gx),
+				_mm256_mullo_epi32(_mm256_and_si256(_mm256_srli_epi32(d, 8), low), fx));
+			__m256i v = _mm256_srli_epi32(_mm256_add_epi32(_mm256_add_epi32(
+				_mm256_mullo_epi32(top, gy), _mm256_mullo_epi32(bottom, fy)), half), 16);
+
+			__m256i n = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(noise + nx)));
+			__m256i out = _mm256_srli_epi32(_mm256_add_epi32(_mm256_add_epi32(
+				_mm256_mullo_epi32(v, rest), _mm256_mullo_epi32(n, alpha)), round), 8);
+			out = _mm256_blendv_epi8(out, white, _mm256_cmpeq_epi32(src, blank));
+
+			/* eight 32-bit lanes down to eight bytes */
+			__m128i lo = _mm256_castsi256_si128(out), hi = _mm256_extracti128_si256(out, 1);
+			__m128i words = _mm_packus_epi32(lo, hi);
+			_mm_storel_epi64((__m128i*)(b.next + p), _mm_packus_epi16(words, words));
+		}
+		for (; x < b.width; x++)
+			b.next[row + x] = warp_pixel(b, row + x, noise[x % b.tile]);
+	}
+}
+
+#endif /* HAVE_X86 */
+
+static void warp_band(IbfvBand b)
+{
+#ifdef HAVE_X86
+	if (cpu_has_avx2()) {
+		warp_band_avx2(b);
+		return;
+	}
+#endif
+	warp_band_scalar(b);
+}
+
+void IbfvEngine::step(int nthreads)
+{
+	if (view_poly == NULL || w < 2 || h < 2)
+		return;
+
+	if (nthreads <= 0)
+		nthreads = (int)std::thread::hardware_concurrency();
+	if (nthreads <= 0)
+		nthreads = 1;
+	/* a band has to be worth starting a thread for */
+	if (nthreads > h / 32)
+		nthreads = h / 32 > 0 ? h / 32 : 1;
+
+	int npat = options.patterns > 0 ? options.patterns : 1;
+	IbfvBand band;
+	band.source = source.data();
+	band.weights = weights.data();
+	band.last = frame.data();
+	band.next = scratch.data();
+	band.pattern = &noise[(size_t)(iframe % npat) * tile * tile];
+	band.tile = tile;
+	band.width = w;
+	band.alpha = (int)(options.alpha * 256 + 0.5);
+	band.blank = w * h;
+
+	std::vector<std::thread> workers;
+	for (int i = 0; i < nthreads; i++) {
+		band.row0 = (int)((long long)h * i / nthreads);
+		band.row1 = (int)((long long)h * (i + 1) / nthreads);
+		if (i + 1 < nthreads)
+			workers.push_back(std::thread(warp_band, band));
+		else
+			warp_band(band);
+	}
+	for (size_t i = 0; i < workers.size(); i++)
+		workers[i].join();
+
+	frame.swap(scratch);
+	iframe++;
+}
@@ -0,0 +1,97 @@
+/*
+
+Image Based Flow Visualization on the CPU
+
+Each IBFV frame warps the previous frame a few pixels along the flow and
+blends a little noise over it (van Wijk's method). Done in OpenGL that
+means a texture upload, a glReadPixels and another upload per frame; here
+the warp is a per-pixel table built from the mesh only when the view
+changes, and a frame is a pass over that table, so the image only has to
+be uploaded once, for drawing.
+
+*/
+
+#ifndef __IBFV_H__
+#define __IBFV_H__
+
+#include <vector>
+
+class Polyhedron;
+
+/// <summary>
+/// The look of the animation. The defaults are those of the original OpenGL version.
+/// </summary>
+struct IbfvOptions {
+	int pattern_size = 64;		/* noise texels per side of a pattern */
+	double scale = 4.0;			/* screen pixels per noise texel, and the warp distance in pixels */
+	int patterns = 32;			/* noise patterns cycled through, one per frame */
+	double alpha = 0.12;		/* how much noise each frame blends in */
+	unsigned int noise_seed = 1;
+};
+
+/// <summary>
+/// Side in screen pixels of a noise pattern magnified options.scale times, as ibfv_noise makes them.
+/// </summary>
+int ibfv_noise_tile(const IbfvOptions& options);
+
+/// <summary>
+/// Noise pattern k of options.patterns, magnified to screen pixels: ibfv_noise_tile rows of as many gray bytes,
+/// bottom row first, to be repeated over the screen.
+/// </summary>
+void ibfv_noise(const IbfvOptions& options, int k, std::vector<unsigned char>& pattern);
+
+class IbfvEngine {
+public:
+	IbfvEngine();
+
+	IbfvOptions options;
+
+	/// <summary>
+	/// Points the engine at poly as drawn with the given OpenGL matrices (column major, as glGetDoublev returns them)
+	/// and viewport. The warp table is only rebuilt if one of them changed; a new size also restarts the animation.
+	/// </summary>
+	/// <returns>True if the warp table was rebuilt.</returns>
+	bool set_view(Polyhedron* poly, const double modelview[16], const double projection[16], const int viewport[4]);
+
+	/// <summary>
+	/// Forgets the view, so the next set_view rebuilds the table even for the same mesh and matrices,
+	/// e.g. after the mesh was replaced by another at the same address. The noise is made again from options.
+	/// </summary>
+	void invalidate();
+
+	/// <summary>
+	/// Advances the animation one frame on nthreads threads (all cores if 0). Does nothing before set_view.
+	/// </summary>
+	void step(int nthreads = 0);
+
+	/// <summary>
+	/// The current frame: height() rows of width() gray bytes, bottom row first. Pixels off the mesh are white,
+	/// so the frame can be drawn over the whole viewport as it is.
+	/// </summary>
+	const unsigned char* image() const { return frame.data(); }
+	int width() const { return w; }
+	int height() const { return h; }
+
+private:
+	void make_patterns();
+	void build_table(Polyhedron* poly, const double modelview[16], const double projection[16]);
+
+	int w, h;
+	int iframe;
+
+	Polyhedron* view_poly;
+	double view_matrix[32];		/* modelview then projection the table was built for */
+	int view_port[4];
+
+	/* per pixel: where in the last frame to read, and the bilinear weights packed as fx | fy << 16 */
+	std::vector<int> source;
+	std::vector<int> weights;
+
+	/* frames are w * h bytes followed by w + 4 bytes of white, which the table points uncovered pixels at */
+	std::vector<unsigned char> frame, scratch;
+
+	int tile;							/* side of a magnified noise pattern */
+	std::vector<unsigned char> noise;	/* options.patterns tiles of tile * tile bytes */
+};
+
+#endif /* __IBFV_H__ */
@@ -0,0 +1,314 @@
+/*
+
+Image Based Flow Visualization in framebuffer objects
+
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "polyhedron.h"
+#include "vertex_attributes.h"
+#include "ibfv_gpu.h"
+
+IbfvGpu::IbfvGpu()
+	: w(0), h(0), iframe(0), current(0), failed(false), mesh_poly(NULL), view_poly(NULL), index_count(0)
+{
+	memset(view_matrix, 0, sizeof(view_matrix));
+	memset(view_port, 0, sizeof(view_port));
+	memset(frames, 0, sizeof(frames));
+	memset(framebuffers, 0, sizeof(framebuffers));
+	memset(buffers, 0, sizeof(buffers));
+}
+
+bool IbfvGpu::supported()
+{
+	return GLEW_VERSION_1_5 && (GLEW_VERSION_3_0 || GLEW_ARB_framebuffer_object);
+}
+
+/* the noise as textures, already magnified as the CPU engine uses it, so a frame reads it a pixel a texel */
+void IbfvGpu::make_patterns()
+{
+	int tile = ibfv_noise_tile(options);
+	int npat = options.patterns > 0 ? options.patterns : 1;
+
+	if (!patterns.empty())
+		glDeleteTextures((GLsizei)patterns.size(), patterns.data());
+	patterns.resize(npat);
+	glGenTextures(npat, patterns.data());
+
+	std::vector<unsigned char> pattern;
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	for (int k = 0; k < npat; k++) {
+		ibfv_noise(options, k, pattern);
+		glBindTexture(GL_TEXTURE_2D, patterns[k]);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE, tile, tile, 0, GL_LUMINANCE, GL_UNSIGNED_BYTE, pattern.data());
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+/******************************************************************************
+The two frames at the viewport's size, both cleared to white, each the
+color attachment of its own framebuffer.
+******************************************************************************/
+bool IbfvGpu::make_frames()
+{
+	GLint last_framebuffer = 0;
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &last_framebuffer);
+	glPushAttrib(GL_COLOR_BUFFER_BIT);
+
+	if (frames[0] == 0) {
+		glGenTextures(2, frames);
+		glGenFramebuffers(2, framebuffers);
+	}
+	bool complete = true;
+	for (int i = 0; i < 2; i++) {
+		glBindTexture(GL_TEXTURE_2D, frames[i]);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[i]);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, frames[i], 0);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+			complete = false;
+			break;
+		}
+		glClearColor(1, 1, 1, 1);
+		glClear(GL_COLOR_BUFFER_BIT);
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glPopAttrib();
+	glBindFramebuffer(GL_FRAMEBUFFER, last_framebuffer);
+	if (!complete)
+		fprintf(stderr, "IBFV framebuffers are incomplete, advecting on the CPU instead\n");
+	return complete;
+}
+
+/* positions and triangles only change with the mesh */
+void IbfvGpu::build_mesh(Polyhedron* poly)
+{
+	const VertexAttributes& attr = poly->attributes;
+	int nverts = attr.size();
+	std::vector<float> positions(3 * (size_t)nverts);
+	for (int i = 0; i < nverts; i++) {
+		positions[3 * i] = (float)attr.x[i];
+		positions[3 * i + 1] = (float)attr.y[i];
+		positions[3 * i + 2] = (float)attr.z[i];
+	}
+
+	/* two triangles per quad, split as the CPU engine splits them */
+	static const int fan[6] = { 0, 1, 2, 0, 2, 3 };
+	std::vector<GLuint> triangles(6 * (size_t)poly->nquads);
+	for (int i = 0; i < poly->nquads; i++)
+		for (int j = 0; j < 6; j++)
+			triangles[6 * (size_t)i + j] = poly->qlist[i]->verts[fan[j]]->index;
+	index_count = (GLsizei)triangles.size();
+
+	glBindBuffer(GL_ARRAY_BUFFER, buffers[POSITIONS]);
+	glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(float), positions.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[TRIANGLES]);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, triangles.size() * sizeof(GLuint), triangles.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	mesh_poly = poly;
+}
+
+/******************************************************************************
+The texture coordinates of both units. The warp is the vertex's window
+position pushed options.scale pixels along the field, over the frame's
+size, as the original gluProject pass computed it; the noise repeats
+every tile of pixels. All of the first half of the buffer comes before
+all of the second.
+******************************************************************************/
+void IbfvGpu::build_coords(Polyhedron* poly, const double modelview[16], const double projection[16])
+{
+	const VertexAttributes& attr = poly->attributes;
+	int nverts = attr.size();
+	coords.resize(4 * (size_t)nverts);
+	float* warp = coords.data();
+	float* noise = warp + 2 * (size_t)nverts;
+
+	double dmax = options.scale / w;
+	double tile = ibfv_noise_tile(options);
+	for (int i = 0; i < nverts; i++) {
+		double e[4], c[4];
+		for (int k = 0; k < 4; k++)
+			e[k] = modelview[k] * attr.x[i] + modelview[4 + k] * attr.y[i] + modelview[8 + k] * attr.z[i] + modelview[12 + k];
+		for (int k = 0; k < 4; k++)
+			c[k] = projection[k] * e[0] + projection[4 + k] * e[1] + projection[8 + k] * e[2] + projection[12 + k] * e[3];
+		/* a vertex at the eye is clipped away anyway */
+		double px = c[3] != 0 ? (c[0] / c[3] + 1) * 0.5 * w : 0;
+		double py = c[3] != 0 ? (c[1] / c[3] + 1) * 0.5 * h : 0;
+
+		double dx = attr.vx[i], dy = attr.vy[i];
+		double len = sqrt(dx * dx + dy * dy);
+		dx = len > 0 ? dx / len * dmax : 0;
+		dy = len > 0 ? dy / len * dmax : 0;
+		warp[2 * i] = (float)(px / w + dx);
+		warp[2 * i + 1] = (float)(py / h + dy);
+		noise[2 * i] = (float)(px / tile);
+		noise[2 * i + 1] = (float)(py / tile);
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, buffers[COORDS]);
+	glBufferData(GL_ARRAY_BUFFER, coords.size() * sizeof(float), coords.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+bool IbfvGpu::set_view(Polyhedron* poly, const double modelview[16], const double projection[16], const int viewport[4])
+{
+	if (failed || !supported())
+		return false;
+	if (viewport[2] < 2 || viewport[3] < 2)
+		return true;
+	if (patterns.empty())
+		make_patterns();
+	if (buffers[0] == 0)
+		glGenBuffers(SLOTS, buffers);
+
+	if (poly == view_poly && memcmp(view_matrix, modelview, 16 * sizeof(double)) == 0 &&
+		memcmp(view_matrix + 16, projection, 16 * sizeof(double)) == 0 &&
+		memcmp(view_port, viewport, sizeof(view_port)) == 0)
+		return true;
+
+	if (viewport[2] != w || viewport[3] != h) {
+		w = viewport[2];
+		h = viewport[3];
+		iframe = 0;
+		current = 0;
+		if (!make_frames()) {
+			failed = true;
+			view_poly = NULL;
+			return false;
+		}
+	}
+	if (poly != mesh_poly)
+		build_mesh(poly);
+	view_poly = poly;
+	memcpy(view_matrix, modelview, 16 * sizeof(double));
+	memcpy(view_matrix + 16, projection, 16 * sizeof(double));
+	memcpy(view_port, viewport, sizeof(view_port));
+
+	build_coords(poly, modelview, projection);
+	return true;
+}
+
+void IbfvGpu::invalidate()
+{
+	view_poly = NULL;
+	mesh_poly = NULL;
+	if (!patterns.empty())
+		glDeleteTextures((GLsizei)patterns.size(), patterns.data());
+	patterns.clear();
+}
+
+/******************************************************************************
+One frame: the mesh drawn into the other framebuffer, reading the last
+frame through the warp on the first texture unit and this frame's noise
+on the second, which mixes in options.alpha of it as the old blended pass
+did. Everything off the mesh stays the white it was cleared to.
+******************************************************************************/
+void IbfvGpu::step()
+{
+	if (view_poly == NULL || failed)
+		return;
+
+	GLint last_framebuffer = 0;
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &last_framebuffer);
+	glPushAttrib(GL_COLOR_BUFFER_BIT | GL_ENABLE_BIT | GL_TEXTURE_BIT | GL_VIEWPORT_BIT | GL_LIGHTING_BIT);
+
+	int next = 1 - current;
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[next]);
+	glViewport(0, 0, w, h);
+	glClearColor(1, 1, 1, 1);
+	glClear(GL_COLOR_BUFFER_BIT);
+
+	glDisable(GL_LIGHTING);
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_CULL_FACE);
+	glDisable(GL_BLEND);
+	glShadeModel(GL_SMOOTH);
+
+	glActiveTexture(GL_TEXTURE0);
+	glEnable(GL_TEXTURE_2D);
+	glBindTexture(GL_TEXTURE_2D, frames[current]);
+	glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
+
+	GLfloat mix[4] = { 0, 0, 0, (GLfloat)options.alpha };
+	glActiveTexture(GL_TEXTURE1);
+	glEnable(GL_TEXTURE_2D);
+	glBindTexture(GL_TEXTURE_2D, patterns[iframe % patterns.size()]);
+	glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_COMBINE);
+	glTexEnvi(GL_TEXTURE_ENV, GL_COMBINE_RGB, GL_INTERPOLATE);
+	glTexEnvi(GL_TEXTURE_ENV, GL_SOURCE0_RGB, GL_TEXTURE);
+	glTexEnvi(GL_TEXTURE_ENV, GL_SOURCE1_RGB, GL_PREVIOUS);
+	glTexEnvi(GL_TEXTURE_ENV, GL_SOURCE2_RGB, GL_CONSTANT);
+	glTexEnvi(GL_TEXTURE_ENV, GL_OPERAND2_RGB, GL_SRC_ALPHA);
+	glTexEnvfv(GL_TEXTURE_ENV, GL_TEXTURE_ENV_COLOR, mix);
+
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glBindBuffer(GL_ARRAY_BUFFER, buffers[POSITIONS]);
+	glVertexPointer(3, GL_FLOAT, 0, 0);
+	glBindBuffer(GL_ARRAY_BUFFER, buffers[COORDS]);
+	for (int unit = 0; unit < 2; unit++) {
+		glClientActiveTexture(GL_TEXTURE0 + unit);
+		glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+		glTexCoordPointer(2, GL_FLOAT, 0, (const void*)(unit * coords.size() / 2 * sizeof(float)));
+	}
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[TRIANGLES]);
+	glDrawElements(GL_TRIANGLES, index_count, GL_UNSIGNED_INT, 0);
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	for (int unit = 1; unit >= 0; unit--) {
+		glClientActiveTexture(GL_TEXTURE0 + unit);
+		glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+	}
+	glDisableClientState(GL_VERTEX_ARRAY);
+
+	glPopAttrib();
+	glBindFramebuffer(GL_FRAMEBUFFER, last_framebuffer);
+
+	current = next;
+	iframe++;
+}
+
+void IbfvGpu::draw()
+{
+	if (view_poly == NULL || failed)
+		return;
+
+	GLint last_framebuffer = 0;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &last_framebuffer);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffers[current]);
+	glBlitFramebuffer(0, 0, w, h, view_port[0], view_port[1], view_port[0] + w, view_port[1] + h,
+		GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_FRAMEBUFFER, last_framebuffer);
+}
+
+void IbfvGpu::release()
+{
+	if (frames[0] != 0) {
+		glDeleteFramebuffers(2, framebuffers);
+		glDeleteTextures(2, frames);
+	}
+	memset(frames, 0, sizeof(frames));
+	memset(framebuffers, 0, sizeof(framebuffers));
+	if (buffers[0] != 0)
+		glDeleteBuffers(SLOTS, buffers);
+	memset(buffers, 0, sizeof(buffers));
+	if (!patterns.empty())
+		glDeleteTextures((GLsizei)patterns.size(), patterns.data());
+	patterns.clear();
+	view_poly = mesh_poly = NULL;
+	w = h = 0;
+}
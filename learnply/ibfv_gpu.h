@@ -0,0 +1,103 @@
+/*
+
+Image Based Flow Visualization in framebuffer objects
+
+The same animation as IbfvEngine, kept on the graphics card: the frames
+are two textures, each attached to a framebuffer object, and a step draws
+the mesh into one, in a single pass reading the other through the warped
+texture coordinates and mixing in the noise on a second texture unit. The
+two swap roles every frame and the current one is blitted to the window,
+so nothing is read back or uploaded per frame. The warped coordinates sit
+in a buffer object, rebuilt only when the view changes, like the CPU
+engine's table.
+
+*/
+
+#ifndef __IBFV_GPU_H__
+#define __IBFV_GPU_H__
+
+#include <vector>
+#include "gl/glew.h"
+#include "ibfv.h"
+
+class Polyhedron;
+
+class IbfvGpu {
+public:
+	IbfvGpu();
+
+	IbfvOptions options;
+
+	/// <summary>
+	/// Whether the context has the framebuffer objects and buffer objects the engine draws with.
+	/// </summary>
+	static bool supported();
+
+	/// <summary>
+	/// Points the engine at poly as drawn with the given OpenGL matrices (column major, as glGetDoublev returns them)
+	/// and viewport, which should be the current ones. The coordinates are only rebuilt if one of them changed;
+	/// a new size also restarts the animation.
+	/// </summary>
+	/// <returns>False if the context can't run the engine, in which case step does nothing.</returns>
+	bool set_view(Polyhedron* poly, const double modelview[16], const double projection[16], const int viewport[4]);
+
+	/// <summary>
+	/// Forgets the view and the noise, as IbfvEngine::invalidate does.
+	/// </summary>
+	void invalidate();
+
+	/// <summary>
+	/// Advances the animation one frame with the current matrices. Leaves the framebuffer, viewport and
+	/// texture state as they were. Does nothing before set_view.
+	/// </summary>
+	void step();
+
+	/// <summary>
+	/// Copies the current frame over the viewport set_view was given, in the bound framebuffer.
+	/// Pixels off the mesh are white.
+	/// </summary>
+	void draw();
+
+	/// <summary>
+	/// The current frame as a texture, width() by height() and gray in RGBA.
+	/// </summary>
+	GLuint texture() const { return frames[current]; }
+	int width() const { return w; }
+	int height() const { return h; }
+
+	/// <summary>
+	/// Frees the textures, framebuffers and buffer objects. Needs the OpenGL context they were made in.
+	/// </summary>
+	void release();
+
+private:
+	IbfvGpu(const IbfvGpu&);
+	IbfvGpu& operator=(const IbfvGpu&);
+
+	void make_patterns();
+	bool make_frames();
+	void build_mesh(Polyhedron* poly);
+	void build_coords(Polyhedron* poly, const double modelview[16], const double projection[16]);
+
+	enum { POSITIONS, COORDS, TRIANGLES, SLOTS };
+
+	int w, h;
+	int iframe;
+	int current;		/* which of frames holds the last frame */
+	bool failed;		/* the framebuffers could not be completed */
+
+	Polyhedron* mesh_poly;		/* the positions and triangles were built for */
+	Polyhedron* view_poly;
+	double view_matrix[32];		/* modelview then projection the coordinates were built for */
+	int view_port[4];
+
+	GLuint frames[2];
+	GLuint framebuffers[2];
+	std::vector<GLuint> patterns;	/* options.patterns noise textures */
+
+	GLuint buffers[SLOTS];
+	GLsizei index_count;
+	std::vector<float> coords;		/* per vertex: the warped coordinate into the last frame, then the noise coordinate */
+};
+
+#endif /* __IBFV_GPU_H__ */
@@ -15,6 +15,19 @@
 #include "icMatrix.H"
 #include "polyhedron.h"
 #include "polyline.h"
+#include "boids.h"
+#include "tools.h"
+#include "topo_cache.h"
+#include "streamline.h"
+#include "streamline_placement.h"
+#include "pathline.h"
+#include "result_cache.h"
+#include "lic.h"
+#include "ibfv.h"
+#include "ibfv_gpu.h"
+#include "mesh_renderer.h"
+#include "glyph_renderer.h"
+#include "streamline_renderer.h"
 #include "trackball.h"
 #include "tmatrix.h"
 
@@ -27,9 +40,21 @@ using std::string;
 Polyhedron* poly;
 
 /* random globals */
-vector<PolyLine> streamlines;
+StreamlineStore streamlines;
 vector<LineSegment> vectors;
 bool displayStreamlines = false;
+TraceOptions trace_options; // integrator and stopping criteria for streamlines, cycle the integrator with 'i'
+bool evenly_spaced = false; // place streamlines evenly instead of from every third vertex, toggle with 'e'
+PlacementOptions placement_options;
+StreamlineStore timelines; // pathlines or streaklines of the time series, whichever timelines_mode says
+int timelines_mode = 0; // display mode the timelines were traced for, 0 if none yet
+ResultCache results; // vectors and streamlines already generated, by dataset and parameters
+LicOptions lic_options; // size of the LIC texture and its filter
+GLuint lic_texture = 0;
+bool lic_current = false; // lic_texture shows the mesh that's loaded now
+MeshRenderer mesh_renderer; // the mesh as vertex buffers, drawn in one call by every mode
+GlyphRenderer glyphs; // an arrow per gathered vector, drawn in one call by mode 7
+StreamlineRenderer streamline_batch, timeline_batch; // streamlines and timelines, each drawn in one call
 
 /*scene related variables*/
 const float zoomspeed = 0.9;
@@ -81,6 +106,9 @@ display mode 3: render each quad with colors of vertices
 display mode 4: Drawing example
 display mode 5: Image-based Flow Visualization (IBFV)
 display mode 6: Grayscale scalar field.
+display mode 9: Pathlines through the long*.boids.ply time series.
+display mode 10 (key 0): Streaklines through the same series.
+display mode 11 (key l): Line Integral Convolution (LIC), computed on the CPU.
 */
 int display_mode = 1;
 
@@ -98,13 +126,10 @@ int mouse_mode = -2;	// -1 = no action, 1 = tranlate y, 2 = rotate
 
 /*IBFV related variables*/
 //https://www.win.tue.nl/~vanwijk/ibfv/
-#define	NPN 64
-#define SCALE 4.0
-int    Npat = 32;
-int    iframe = 0;
-float  tmax = win_width / (SCALE*NPN);
-float  dmax = SCALE / win_width;
-unsigned char *pixels;
+IbfvEngine ibfv; // advects and blends the frames on the CPU, see ibfv.h for the noise and warp settings
+GLuint ibfv_texture = 0;
+IbfvGpu ibfv_gpu; // the same in framebuffer objects, used instead where the context has them
+bool ibfv_on_gpu = true; // toggled with g
 
 #define DM  ((float) (1.0/(100-1.0)))
 
@@ -114,12 +139,12 @@ Forward declaration of functions
 
 void init(void);
 void makePatterns(void);
+void makeLIC(void);
 
 /* custom functions */
-void extract_streamline(double, double, double, PolyLine&);
 double magnitude(Vertex* v);
-icVector3 getDir(double, double, double);
 void gatherStreamlines();
+void gatherTimelines(int mode);
 void gatherVectors(Polyhedron * poly);
 
 /*glut attaching functions*/
@@ -139,16 +164,10 @@ void display_selected_quad(Polyhedron* poly);
 /*display vis results*/
 void display_polyhedron(Polyhedron* poly);
 
-void drawArrowhead(LineSegment& vectorArrow);
-
 /*display utilities*/
 
 void scalar_bounds(Polyhedron* poly, double* lower, double* upper);
 
-void display_grayscale_quad(Quad* qu, double lower, double upper);
-
-void display_bicolor_quad(Quad* qu, double lower, double upper, float lower_color[3], float upper_color[3]);
-
 void display_heightmod_quad(Quad* qu, double lower, double upper, float ref_color[3], float peak);
 
 void display_grayscale_heightmod_quad(Quad* qu, double lower, double upper, float peak);
@@ -159,7 +178,8 @@ void display_bicolor_heightmod_quad(Quad* qu, double lower, double upper, float
 /// <summary>
 /// Loads a polyhedron from a file and outputs to the <see cref="poly"/> global variable.
 /// </summary>
-/// <param name="ply_path">The path to the polyhedron to be loaded. Must be in PLY format</param>
+/// <param name="ply_path">The path to the polyhedron to be loaded. Must be in PLY format, or a raw <c>.boids</c> log,
+/// which is rasterized at <see cref="BOIDS_GRID_SIZE"/> without going through the transformer.</param>
 void load_ply(char* ply_path);
 
 
@@ -235,7 +255,7 @@ R: the red channel of the color, ranges [0, 1]
 G: the green channel of the color, ranges [0, 1]
 B: the blue channel of the color, ranges [0, 1]
 */
-void drawPolyline(PolyLine pl, double width = 1.0, double R = 1.0, double G = 0.0, double B = 0.0) {
+void drawPolyline(const LineSegment* segments, int count, double width = 1.0, double R = 1.0, double G = 0.0, double B = 0.0) {
 	
 	glDisable(GL_LIGHTING);
 	glEnable(GL_LINE_SMOOTH);
@@ -247,9 +267,9 @@ void drawPolyline(PolyLine pl, double width = 1.0, double R = 1.0, double G = 0.
 	glBegin(GL_LINES);
 	glColor3f(R, G, B);
 
-	for (int i = 0; i < pl.size(); i++) {
-		glVertex3f(pl[i].start.x, pl[i].start.y, pl[i].start.z);
-		glVertex3f(pl[i].end.x, pl[i].end.y, pl[i].end.z);
+	for (int i = 0; i < count; i++) {
+		glVertex3f(segments[i].start.x, segments[i].start.y, segments[i].start.z);
+		glVertex3f(segments[i].end.x, segments[i].end.y, segments[i].end.z);
 	}
 
 	glEnd();
@@ -257,19 +277,37 @@ void drawPolyline(PolyLine pl, double width = 1.0, double R = 1.0, double G = 0.
 	glDisable(GL_BLEND);
 }
 
+void drawPolyline(const PolyLine& pl, double width = 1.0, double R = 1.0, double G = 0.0, double B = 0.0) {
+	drawPolyline(pl.data(), (int)pl.size(), width, R, G, B);
+}
+
 /******************************************************************************
 Main program.
 ******************************************************************************/
 int main(int argc, char* argv[])
 {
+	/*batch tools such as -binary exit without opening a window*/
+	int tool_result = run_tool(argc, argv);
+	if (tool_result >= 0)
+		return tool_result;
+
 	/*load mesh from ply file*/
 	//Original path: "../quadmesh_2D/fun_shapes/face.ply"
 	char* to_load = new char[256];
 	strcpy(to_load, LOAD_PATHS[load_selector]);
+	if (argc > 1 && argv[1][0] != '-') { // Open a specific .ply or .boids file instead
+		strncpy(to_load, argv[1], 255);
+		to_load[255] = '\0';
+	}
+	results.persist = true; // keep generated lines next to the datasets across runs
+	glyphs.style.head_length = ARROWHEAD_LENGTH;
+	glyphs.style.head_angle = ARROWHEAD_ANGLE;
+	glyphs.style.head_min_length = ARROWHEAD_LENGTH * VECTOR_LENGTH_SCALAR; // only long arrows get a head
+	glyphs.style.width = 0.25;
 	load_ply(to_load);
 	
 	/*initialize the mesh*/
-	poly->initialize(); // initialize the mesh
+	initialize_cached(poly, to_load); // initialize the mesh, from its .topo cache if there is one
 	// poly->write_info();
 
 
@@ -279,6 +317,7 @@ int main(int argc, char* argv[])
 	glutInitWindowPosition(20, 20);
 	glutInitWindowSize(win_width, win_height);
 	glutCreateWindow("Scientific Visualization");
+	glewInit(); // buffer objects for the mesh renderer
 
 
 	/*initialize openGL*/
@@ -301,7 +340,6 @@ int main(int argc, char* argv[])
 	
 	/*clear memory before exit*/
 	poly->finalize();	// finalize everything
-	free(pixels);
 	return 0;
 }
 
@@ -593,11 +631,6 @@ void reshape(int width, int height) {
 	glViewport(0, 0, width, height);
 
 	set_view(GL_RENDER);
-
-	/*Update pixels buffer*/
-	free(pixels);
-	pixels = (unsigned char *)malloc(sizeof(unsigned char)*win_width*win_height * 3);
-	memset(pixels, 255, sizeof(unsigned char)*win_width*win_height * 3);
 }
 
 
@@ -780,32 +813,35 @@ void mousewheel(int wheel, int direction, int x, int y) {
 /*Display IBFV*/
 void makePatterns(void)
 {
-	pixels = (unsigned char *)malloc(sizeof(unsigned char)*win_width*win_height * 3);
-	memset(pixels, 255, sizeof(unsigned char)*win_width*win_height * 3);
-
-	int lut[256];
-	int phase[NPN][NPN];
-	GLubyte pat[NPN][NPN][4];
-	int i, j, k, t;
-
-	for (i = 0; i < 256; i++) lut[i] = i < 127 ? 0 : 255;
-	for (i = 0; i < NPN; i++)
-		for (j = 0; j < NPN; j++) phase[i][j] = rand() % 256;
-
-	for (k = 0; k < Npat; k++) {
-		t = k * 256 / Npat;
-		for (i = 0; i < NPN; i++)
-			for (j = 0; j < NPN; j++) {
-				pat[i][j][0] =
-					pat[i][j][1] =
-					pat[i][j][2] = lut[(t + phase[i][j]) % 255];
-				pat[i][j][3] = int(0.12 * 255);
-			}
-		glNewList(k + 1, GL_COMPILE);
-		glTexImage2D(GL_TEXTURE_2D, 0, 4, NPN, NPN, 0, GL_RGBA, GL_UNSIGNED_BYTE, pat);
-		glEndList();
+	// the engines make their noise again and rebuild their warps for the mesh now loaded
+	ibfv.invalidate();
+	ibfv_gpu.invalidate();
+}
+
+/******************************************************************************
+Computes the LIC of the current mesh over its bounding box into lic_texture
+******************************************************************************/
+
+void makeLIC(void)
+{
+	std::vector<unsigned char> image;
+	lic_current = true;
+	if (!compute_lic(poly, lic_options, image)) {
+		printf("Could not compute the LIC of this mesh.\n");
+		return;
 	}
 
+	if (lic_texture == 0)
+		glGenTextures(1, &lic_texture);
+	glBindTexture(GL_TEXTURE_2D, lic_texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE, lic_options.width, lic_options.height, 0, GL_LUMINANCE, GL_UNSIGNED_BYTE, image.data());
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glBindTexture(GL_TEXTURE_2D, 0);
 }
 
 void displayIBFV(void)
@@ -816,80 +852,41 @@ void displayIBFV(void)
 	glDisable(GL_POLYGON_OFFSET_FILL);
 	glDisable(GL_DEPTH_TEST);
 
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
-
-	glEnable(GL_TEXTURE_2D);
-	glShadeModel(GL_FLAT);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-	glClearColor(1.0, 1.0, 1.0, 1.0);  // background for rendering color coding and lighting
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-	/*draw the model with using the pixels, using vector field to advert the texture coordinates*/
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, win_width, win_height, 0, GL_RGB, GL_UNSIGNED_BYTE, pixels);
-
+	/*advect the last frame and blend in noise; the warp is only recomputed when the view changes*/
 	double modelview_matrix1[16], projection_matrix1[16];
 	int viewport1[4];
 	glGetDoublev(GL_MODELVIEW_MATRIX, modelview_matrix1);
 	glGetDoublev(GL_PROJECTION_MATRIX, projection_matrix1);
 	glGetIntegerv(GL_VIEWPORT, viewport1);
-
-	for (int i = 0; i < poly->nquads; i++) { //go through all the quads
-
-		Quad *temp_q = poly->qlist[i];
-
-		glBegin(GL_QUADS);
-
-		for (int j = 0; j < 4; j++) {
-			Vertex *temp_v = temp_q->verts[j];
-
-			double x = temp_v->x;
-			double y = temp_v->y;
-
-			double tx, ty, dummy;
-
-			gluProject((GLdouble)temp_v->x, (GLdouble)temp_v->y, (GLdouble)temp_v->z,
-				modelview_matrix1, projection_matrix1, viewport1, &tx, &ty, &dummy);
-
-			tx = tx / win_width;
-			ty = ty / win_height;
-
-			icVector2 dp = icVector2(temp_v->vx, temp_v->vy);
-			normalize(dp);
-
-			double dx = dp.x;
-			double dy = dp.y;
-
-			double r = dx * dx + dy * dy;
-			if (r > dmax*dmax) {
-				r = sqrt(r);
-				dx *= dmax / r;
-				dy *= dmax / r;
-			}
-
-			float px = tx + dx;
-			float py = ty + dy;
-
-			glTexCoord2f(px, py);
-			glVertex3d(temp_v->x, temp_v->y, temp_v->z);
-		}
-		glEnd();
+	if (ibfv_on_gpu && ibfv_gpu.set_view(poly, modelview_matrix1, projection_matrix1, viewport1)) {
+		/*the frames never leave the card; the one just made is copied to the window*/
+		ibfv_gpu.step();
+		ibfv_gpu.draw();
+		return;
 	}
+	ibfv.set_view(poly, modelview_matrix1, projection_matrix1, viewport1);
+	ibfv.step();
+
+	/*the frame is the whole viewport, so it goes up once and is drawn as one quad*/
+	if (ibfv_texture == 0)
+		glGenTextures(1, &ibfv_texture);
+	glBindTexture(GL_TEXTURE_2D, ibfv_texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE, ibfv.width(), ibfv.height(), 0, GL_LUMINANCE, GL_UNSIGNED_BYTE, ibfv.image());
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
 
-	iframe = iframe + 1;
-
-	glEnable(GL_BLEND);
+	glEnable(GL_TEXTURE_2D);
+	glShadeModel(GL_FLAT);
 
-	/*blend the drawing with another noise image*/
 	glMatrixMode(GL_PROJECTION);
 	glPushMatrix();
 	glLoadIdentity();
 
-
 	glMatrixMode(GL_MODELVIEW);
 	glPushMatrix();
 	glLoadIdentity();
@@ -897,16 +894,12 @@ void displayIBFV(void)
 	glTranslatef(-1.0, -1.0, 0.0);
 	glScalef(2.0, 2.0, 1.0);
 
-	glCallList(iframe % Npat + 1);
-
 	glBegin(GL_QUAD_STRIP);
-
 	glTexCoord2f(0.0, 0.0);  glVertex2f(0.0, 0.0);
-	glTexCoord2f(0.0, tmax); glVertex2f(0.0, 1.0);
-	glTexCoord2f(tmax, 0.0);  glVertex2f(1.0, 0.0);
-	glTexCoord2f(tmax, tmax); glVertex2f(1.0, 1.0);
+	glTexCoord2f(0.0, 1.0); glVertex2f(0.0, 1.0);
+	glTexCoord2f(1.0, 0.0);  glVertex2f(1.0, 0.0);
+	glTexCoord2f(1.0, 1.0); glVertex2f(1.0, 1.0);
 	glEnd();
-	glDisable(GL_BLEND);
 
 	glMatrixMode(GL_MODELVIEW);
 	glPopMatrix();
@@ -914,34 +907,9 @@ void displayIBFV(void)
 	glMatrixMode(GL_PROJECTION);
 	glPopMatrix();
 
-	glReadPixels(0, 0, win_width, win_height, GL_RGB, GL_UNSIGNED_BYTE, pixels);
-
-
-	/*draw the model with using pixels, note the tx and ty do not take the vector on points*/
-	glClearColor(1.0, 1.0, 1.0, 1.0);  // background for rendering color coding and lighting
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, win_width, win_height, 0, GL_RGB, GL_UNSIGNED_BYTE, pixels);
-	for (int i = 0; i < poly->nquads; i++) { //go through all the quads
-		Quad *temp_q = poly->qlist[i];
-		glBegin(GL_QUADS);
-		for (int j = 0; j < 4; j++) {
-			Vertex *temp_v = temp_q->verts[j];
-			double x = temp_v->x;
-			double y = temp_v->y;
-			double tx, ty, dummy;
-			gluProject((GLdouble)temp_v->x, (GLdouble)temp_v->y, (GLdouble)temp_v->z,
-				modelview_matrix1, projection_matrix1, viewport1, &tx, &ty, &dummy);
-			tx = tx / win_width;
-			ty = ty / win_height;
-			glTexCoord2f(tx, ty);
-			glVertex3d(temp_v->x, temp_v->y, temp_v->z);
-		}
-		glEnd();
-	}
-
+	glBindTexture(GL_TEXTURE_2D, 0);
 	glDisable(GL_TEXTURE_2D);
 	glShadeModel(GL_SMOOTH);
-	glDisable(GL_BLEND);
 }
 
 /******************************************************************************
@@ -983,16 +951,71 @@ Collects a bunch of streamlines in a mesh
 ******************************************************************************/
 
 void gatherStreamlines() {
-	streamlines.clear();
+	const int seed_stride = 3;
+	const TraceOptions& o = trace_options;
+	vector<double> params = { (double)o.integrator, o.step, o.min_step, o.max_step, o.tolerance,
+		o.max_length, (double)o.max_steps, o.min_speed };
+	if (evenly_spaced)
+		params.insert(params.end(), { placement_options.separation, placement_options.test_ratio, placement_options.min_length });
+	else
+		params.push_back(seed_stride);
+	ResultKind kind = evenly_spaced ? RESULT_PLACED_STREAMLINES : RESULT_STREAMLINES;
+	if (results.find(kind, params, streamlines)) {
+		streamline_batch.set_lines(streamlines);
+		return;
+	}
 
-	for (int i = 0; i < poly->nverts; i += 3) {
-		int x = poly->vlist[i]->x;
-		int y = poly->vlist[i]->y;
+	if (evenly_spaced) {
+		place_streamlines(poly, trace_options, placement_options, streamlines);
+	}
+	else {
+		vector<icVector3> seeds;
+		for (int i = 0; i < poly->nverts; i += seed_stride) {
+			int x = poly->vlist[i]->x;
+			int y = poly->vlist[i]->y;
+			seeds.push_back(icVector3(x, y, 0));
+		}
 
-		PolyLine line;
-		extract_streamline(x, y, 0, line);
-		streamlines.push_back(line);
+		// traced on all cores; the lines come back in seed order either way
+		trace_streamlines(poly, trace_options, seeds, streamlines);
 	}
+	results.store(kind, params, streamlines);
+	streamline_batch.set_lines(streamlines);
+}
+
+/******************************************************************************
+Traces pathlines (mode 9) or streaklines (mode 10) through the time series
+in LOAD_PATHS, from every third vertex of the current mesh for pathlines
+and every 27th for streaklines, which each release a particle per step.
+******************************************************************************/
+
+void gatherTimelines(int mode) {
+	vector<FieldSlice> slices;
+	for (int i = 0; i < LOADABLE_COUNT; i++) {
+		FieldSlice slice;
+		slice.path = LOAD_PATHS[i];
+		if (slice_time_from_name(LOAD_PATHS[i], &slice.time)) // skips the whole-log file, which has no time
+			slices.push_back(slice);
+	}
+	timelines.clear();
+	timelines_mode = mode;
+	timeline_batch.set_lines(timelines);
+	if (slices.empty())
+		return;
+
+	vector<icVector3> seeds;
+	int stride = mode == 9 ? 3 : 27;
+	for (int i = 0; i < poly->nverts; i += stride)
+		seeds.push_back(icVector3(poly->vlist[i]->x, poly->vlist[i]->y, poly->vlist[i]->z));
+
+	TimeVaryingField field(slices);
+	ParticleTracer tracer(&field);
+	double t0 = field.start_time(), t1 = field.end_time();
+	double dt = (t1 - t0) / 400;
+	bool ok = mode == 9 ? tracer.trace_pathlines(seeds, t0, t1, dt, timelines) : tracer.trace_streaklines(seeds, t0, t1, dt, timelines);
+	if (!ok)
+		printf("Could not read the time series.\n");
+	timeline_batch.set_lines(timelines);
 }
 
 /******************************************************************************
@@ -1000,14 +1023,18 @@ Collects a bunch of vectors in a mesh
 ******************************************************************************/
 
 void gatherVectors(Polyhedron * poly) {
+	vector<double> params = { VECTOR_LENGTH_SCALAR };
+	if (results.find(RESULT_VECTORS, params, vectors)) {
+		glyphs.set_glyphs(vectors.data(), (int)vectors.size());
+		return;
+	}
+
 	vectors.clear();
 	int vertsPerRow = sqrt(poly->nverts);
-	double maxMagnitude = magnitude(poly->vlist[0]); // MinScalar = 0
 
 	// get max scalar to use as ratio for vector length normalization
-	for (int i = 0; i < poly->nverts; i++)
-		if (magnitude(poly->vlist[i]) > maxMagnitude)
-			maxMagnitude = magnitude(poly->vlist[i]);
+	VertexAttributes& attr = poly->attributes;
+	double maxMagnitude = max_magnitude(attr.vx.data(), attr.vy.data(), attr.vz.data(), attr.size()); // MinScalar = 0
 
 	// gather vectors
 	// only doing the interior rows (ignoring outer ring)
@@ -1029,6 +1056,8 @@ void gatherVectors(Polyhedron * poly) {
 			}
 		}
 	}
+	results.store(RESULT_VECTORS, params, vectors);
+	glyphs.set_glyphs(vectors.data(), (int)vectors.size());
 }
 
 /// <summary>
@@ -1043,132 +1072,6 @@ double magnitude(Vertex* v)
 	return sqrt((v->vx * v->vx) + (v->vy * v->vy) + (v->vz * v->vz));
 }
 
-/******************************************************************************
-Custom function for finding the direction at a specific point
-******************************************************************************/
-
-icVector3 getDir(double x, double y, double z) {
-	Quad* q = NULL;
-	double x1, x2, y1, y2;
-
-	// find quad the point's in
-	for (int i = 0; i < poly->nquads; i++) {
-		q = poly->qlist[i];
-
-		/* find x1, x2, y1, y2
-		   [1] . . . [0]
-			.         .
-			.         .
-			.         .
-		   [2] . . . [3]
-		*/
-		x1 = q->verts[2]->x;
-		y1 = q->verts[2]->y;
-		x2 = q->verts[0]->x;
-		y2 = q->verts[0]->y;
-
-		if (x <= x2 && x >= x1 && y <= y2 && y >= y1)
-			break; // found
-	}
-
-	// find k (usually just 2)
-	int k = -1;
-	for (int i = 0; i < 4; i++) {
-		if (q->verts[i]->x == x1 && q->verts[i]->y == y1)
-			k = i;
-	}
-
-	// find dirX
-	double fx1y1 = q->verts[k]->vx;
-	double fx2y1 = q->verts[(k + 1) % 4]->vx;
-	double fx2y2 = q->verts[(k + 2) % 4]->vx;
-	double fx1y2 = q->verts[(k + 3) % 4]->vx;
-
-	double p1 = ((x2 - x) / (x2 - x1)) * ((y2 - y) / (y2 - y1));
-	double p2 = ((x - x1) / (x2 - x1)) * ((y2 - y) / (y2 - y1));
-	double p3 = ((x2 - x) / (x2 - x1)) * ((y - y1) / (y2 - y1));
-	double p4 = ((x - x1) / (x2 - x1)) * ((y - y1) / (y2 - y1));
-
-	double dirX = (p1 * fx1y1) + (p2 * fx2y1) + (p3 * fx1y2) + (p4 * fx2y2);
-
-	// find dirY
-	fx1y1 = q->verts[k]->vy;
-	fx2y1 = q->verts[(k + 1) % 4]->vy;
-	fx2y2 = q->verts[(k + 2) % 4]->vy;
-	fx1y2 = q->verts[(k + 3) % 4]->vy;
-
-	double dirY = (p1 * fx1y1) + (p2 * fx2y1) + (p3 * fx1y2) + (p4 * fx2y2);
-
-	return icVector3(dirX, dirY, 0);
-}
-
-/******************************************************************************
-Custom function for extracting a files streamline
-******************************************************************************/
-
-void extract_streamline(double x, double y, double z, PolyLine& contour) {
-	double step = .25;
-	int count = 1500;
-	double c_x = x;
-	double c_y = y;
-	double c_z = z;
-
-	// trace forward
-	for (int i = 0; i < count; i++) {
-		// part 1
-		if (c_x > poly->maxx || c_x < poly->minx || c_y > poly->maxy || c_y < poly->miny)
-			continue;
-
-		// part 2
-		icVector3 start = icVector3(c_x, c_y, c_z);
-		icVector3 dir = getDir(c_x, c_y, c_z);
-		normalize(dir);
-		icVector3 end = icVector3((c_x + (dir.x * step)), (c_y + (dir.y * step)), (c_z + (dir.z * step)));
-
-		// part 3
-		c_x = end.x;
-		c_y = end.y;
-		c_z = end.z;
-
-		// part 4
-		if (c_x > poly->maxx || c_x < poly->minx || c_y > poly->maxy || c_y < poly->miny)
-			break;
-
-		LineSegment line = LineSegment(start, end);
-		contour.push_back(line);
-	}
-
-	// reset
-	c_x = x;
-	c_y = y;
-	c_z = z;
-
-	// trace backward
-	for (int i = 0; i < count; i++) {
-		// part 1
-		if (c_x > poly->maxx || c_x < poly->minx || c_y > poly->maxy || c_y < poly->miny)
-			continue;
-
-		// part 2
-		icVector3 start = icVector3(c_x, c_y, c_z);
-		icVector3 dir = -getDir(c_x, c_y, c_z);
-		normalize(dir);
-		icVector3 end = icVector3((c_x + dir.x * step), (c_y + dir.y * step), (c_z + dir.z * step));
-
-		// part 3
-		c_x = end.x;
-		c_y = end.y;
-		c_z = end.z;
-
-		// part 4
-		if (c_x > poly->maxx || c_x < poly->minx || c_y > poly->maxy || c_y < poly->miny)
-			break;
-
-		LineSegment line = LineSegment(start, end);
-		contour.push_back(line);
-	}
-}
-
 /******************************************************************************
 Process a keyboard action.  In particular, exit the program when an
 "escape" is pressed in the window.
@@ -1182,6 +1085,11 @@ void keyboard(unsigned char key, int x, int y) {
 	switch (key) {
 	case 27:
 		poly->finalize();  // finalize_everything
+		mesh_renderer.release();
+		glyphs.release();
+		streamline_batch.release();
+		timeline_batch.release();
+		ibfv_gpu.release();
 		exit(0);
 		break;
 
@@ -1211,6 +1119,8 @@ void keyboard(unsigned char key, int x, int y) {
 				temp_v->B = 0.0;
 			}
 		}
+		poly->attributes.gather_colors(poly->vlist, poly->nverts);
+		mesh_renderer.invalidate();
 		glutPostRedisplay();
 	}
 	break;
@@ -1266,18 +1176,65 @@ void keyboard(unsigned char key, int x, int y) {
 		glutPostRedisplay();
 		break;
 
+	// pathlines and streaklines of the time series
+	case '9':
+	case '0':
+		display_mode = key == '9' ? 9 : 10;
+		if (timelines_mode != display_mode)
+			gatherTimelines(display_mode);
+		glutPostRedisplay();
+		break;
+
+	// LIC of the field
+	case 'l':
+		display_mode = 11;
+		glutPostRedisplay();
+		break;
+
+	// cycle the streamline integrator
+	case 'i':
+		trace_options.integrator = (Integrator)((trace_options.integrator + 1) % INTEGRATOR_COUNT);
+		printf("Streamline integrator: %s\n", integrator_name(trace_options.integrator));
+		streamlines.clear();
+		if (display_mode == 8)
+			gatherStreamlines();
+		glutPostRedisplay();
+		break;
+
+	// toggle where IBFV advects its frames
+	case 'g':
+		ibfv_on_gpu = !ibfv_on_gpu;
+		printf("IBFV: %s\n", ibfv_on_gpu && IbfvGpu::supported() ? "framebuffer objects" : "CPU");
+		glutPostRedisplay();
+		break;
+
+	// toggle evenly spaced streamlines
+	case 'e':
+		evenly_spaced = !evenly_spaced;
+		printf("Streamline placement: %s\n", evenly_spaced ? "evenly spaced" : "every third vertex");
+		streamlines.clear();
+		if (display_mode == 8)
+			gatherStreamlines();
+		glutPostRedisplay();
+		break;
+
     // Increment the load
 	case 'x': {
 		poly->finalize();
+		delete poly;
 		load_selector = (load_selector + 1) % LOADABLE_COUNT;
 		char buffer[256];
 		strcpy(buffer, LOAD_PATHS[load_selector]);
 		load_ply(buffer);
-		poly->initialize(); // initialize the mesh
+		initialize_cached(poly, buffer); // initialize the mesh, from its .topo cache if there is one
 		// poly->write_info();
 		makePatterns();
 		gatherVectors(poly);
 		if (display_mode == 8) gatherStreamlines();
+		timelines_mode = 0; // seeded from the old mesh
+		lic_current = false;
+		mesh_renderer.invalidate(); // the new mesh may well sit where the old one was
+		if (display_mode == 9 || display_mode == 10) gatherTimelines(display_mode);
 		printf("Loaded set %d (%s).\n", load_selector, buffer);
 		
 	}
@@ -1313,6 +1270,7 @@ void display_polyhedron(Polyhedron* poly)
 	scalar_bounds(poly, &lower, &upper); // Find bounds
 	if (!vectors.size())
 		gatherVectors(poly);
+	mesh_renderer.set_mesh(poly); // only builds when the mesh changed
 
 	switch (display_mode) {
 		case 1:
@@ -1328,16 +1286,7 @@ void display_polyhedron(Polyhedron* poly)
 			glMaterialfv(GL_FRONT, GL_SPECULAR, mat_specular);
 			glMaterialf(GL_FRONT, GL_SHININESS, 50.0);
 
-			for (int i = 0; i < poly->nquads; i++) {
-				Quad* temp_q = poly->qlist[i];
-				glBegin(GL_POLYGON);
-				for (int j = 0; j < 4; j++) {
-					Vertex* temp_v = temp_q->verts[j];
-					glNormal3d(temp_v->normal.entry[0], temp_v->normal.entry[1], temp_v->normal.entry[2]);
-					glVertex3d(temp_v->x, temp_v->y, temp_v->z);
-				}
-				glEnd();
-			}
+			mesh_renderer.draw(MESH_NORMALS);
 
 			CHECK_GL_ERROR();
 		}
@@ -1352,19 +1301,8 @@ void display_polyhedron(Polyhedron* poly)
 			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 			glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 			glLineWidth(1.0);
-			for (int i = 0; i < poly->nquads; i++) {
-				Quad* temp_q = poly->qlist[i];
-
-				glBegin(GL_POLYGON);
-				for (int j = 0; j < 4; j++) {
-					Vertex* temp_v = temp_q->verts[j];
-					glNormal3d(temp_q->normal.entry[0], temp_q->normal.entry[1], temp_q->normal.entry[2]);
-					glColor3f(0.0, 0.0, 0.0);
-					glVertex3d(temp_v->x, temp_v->y, temp_v->z);
-				}
-				glEnd();
-
-			}
+			glColor3f(0.0, 0.0, 0.0);
+			mesh_renderer.draw(MESH_OUTLINES);
 
 			glDisable(GL_BLEND);
 		}
@@ -1372,16 +1310,7 @@ void display_polyhedron(Polyhedron* poly)
 
 		case 3:
 			glDisable(GL_LIGHTING);
-			for (int i = 0; i < poly->nquads; i++) {
-				Quad* temp_q = poly->qlist[i];
-				glBegin(GL_POLYGON);
-				for (int j = 0; j < 4; j++) {
-					Vertex* temp_v = temp_q->verts[j];
-					glColor3f(temp_v->R, temp_v->G, temp_v->B);
-					glVertex3d(temp_v->x, temp_v->y, temp_v->z);
-				}
-				glEnd();
-			}
+			mesh_renderer.draw(MESH_VERTEX_COLORS);
 			break;
 
 		case 4:
@@ -1406,16 +1335,8 @@ void display_polyhedron(Polyhedron* poly)
 
 			//display the mesh with color cyan (0.0, 1.0, 1.0)
 			glDisable(GL_LIGHTING);
-			for (int i = 0; i < poly->nquads; i++) {
-				Quad* temp_q = poly->qlist[i];
-				glBegin(GL_POLYGON);
-				for (int j = 0; j < 4; j++) {
-					Vertex* temp_v = temp_q->verts[j];
-					glColor3f(0.0, 1.0, 1.0);
-					glVertex3d(temp_v->x, temp_v->y, temp_v->z);
-				}
-				glEnd();
-			}
+			glColor3f(0.0, 1.0, 1.0);
+			mesh_renderer.draw(0);
 		}
 		break;
 
@@ -1427,82 +1348,49 @@ void display_polyhedron(Polyhedron* poly)
 			float red[3]  = { 1.0, 0.0, 0.0 };
 			float blue[3] = { 0.0, 0.0, 1.0 };
 
-			for (int i = 0; i < poly->nquads; i++) {
-				Quad* temp_q = poly->qlist[i];
-				display_bicolor_quad(temp_q, lower, upper, red, blue);
-			}
+			mesh_renderer.set_color_map(ColorMap(lower, upper, red, blue));
+			mesh_renderer.draw(MESH_SCALAR_COLORS);
 		}
 		break;
 		
 		case 7: {
 			glDisable(GL_LIGHTING);
-			for (int i = 0; i < poly->nquads; i++) {
-				Quad* temp_q = poly->qlist[i];
-				glBegin(GL_POLYGON);
-				for (int j = 0; j < 4; j++) {
-					Vertex* temp_v = temp_q->verts[j];
-					glColor3f(0.0, 0.0, 0.0);
-					glVertex3d(temp_v->x, temp_v->y, temp_v->z);
-				}
-				glEnd();
-			}
+			glColor3f(0.0, 0.0, 0.0);
+			mesh_renderer.draw(0);
 			if (!vectors.size()) // Draw things to appear on top after
 				gatherVectors(poly);
-			for (int i = 0; i < vectors.size(); i++)
-			{
-				LineSegment vectorArrow = vectors.at(i);
-				drawLineSegment(vectorArrow, 0.25, 1, 1, 1);
-				if (vectorArrow.len > ARROWHEAD_LENGTH * VECTOR_LENGTH_SCALAR)
-				{ // If this is a long arrow, add a short arrowhead to it.
-					// This does not take into account the Z dimension
-					drawArrowhead(vectorArrow);
-				}
-			}
+			glyphs.draw(); // the arrows and their heads were made by gatherVectors
 		}
 		break;
 
-		case 8: {
-			for (int i = 0; i < streamlines.size(); i++)
-				drawPolyline(streamlines[i], 1, 1, 1, 1);
+		case 8:
+		case 9:
+		case 10: {
+			/* the lines were handed to their batch when they were traced */
+			StreamlineRenderer& batch = display_mode == 8 ? streamline_batch : timeline_batch;
+			batch.draw(1, 1, 1, 1);
 
 			glDisable(GL_LIGHTING);
-			for (int i = 0; i < poly->nquads; i++) {
-				Quad* temp_q = poly->qlist[i];
-				glBegin(GL_POLYGON);
-				for (int j = 0; j < 4; j++) {
-					Vertex* temp_v = temp_q->verts[j];
-					glColor3f(0.0, 0.0, 0.0);
-					glVertex3d(temp_v->x, temp_v->y, temp_v->z);
-				}
-				glEnd();
-			}
+			glColor3f(0.0, 0.0, 0.0);
+			mesh_renderer.draw(0);
 		}
 		break;
-	}
-}
 
-/// <summary>
-/// Draws an arrowhead associated with a line segment. Assumes directionality of the line segment runs from "start" to "end".
-/// </summary>
-/// <param name="vectorArrow">The arrow to draw a head on.</param>
-/// <remarks>To improve performance, these arrowheads should instead be calculated at the same time as <see cref="gatherVectors(Polyhedron *)"/></remarks>
-void drawArrowhead(LineSegment& vectorArrow)
-{
-	icVector3 tip = vectorArrow.end;
-	icVector3 base = vectorArrow.start;
-	double width = tip.x - base.x;
-	double height = tip.y - base.y;
-	double innerVectorAngle = atan(height / width);
-	if (width < 0)
-		innerVectorAngle += PI; // arctan won't produce an angle between PI/2 and 3PI/2, but we want this.
-	double leftArrowHeadAngle = PI + innerVectorAngle - ARROWHEAD_ANGLE;
-	double rightArrowHeadAngle = PI + innerVectorAngle + ARROWHEAD_ANGLE;
-	icVector3 leftArrowHeadTip(tip.x + ARROWHEAD_LENGTH * cos(leftArrowHeadAngle), tip.y + ARROWHEAD_LENGTH * sin(leftArrowHeadAngle), tip.z);
-	icVector3 rightArrowHeadTip(tip.x + ARROWHEAD_LENGTH * cos(rightArrowHeadAngle), tip.y + ARROWHEAD_LENGTH * sin(rightArrowHeadAngle), tip.z);
-	LineSegment leftArrowHead(tip, leftArrowHeadTip);
-	LineSegment rightArrowHead(tip, rightArrowHeadTip);
-	drawLineSegment(leftArrowHead, 0.25, 1, 1, 1);
-	drawLineSegment(rightArrowHead, 0.25, 1, 1, 1);
+		case 11: {
+			if (!lic_current)
+				makeLIC();
+
+			/* the image covers the bounding box, the same box the renderer scales texture coordinates into */
+			glDisable(GL_LIGHTING);
+			glEnable(GL_TEXTURE_2D);
+			glBindTexture(GL_TEXTURE_2D, lic_texture);
+			glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
+			mesh_renderer.draw(MESH_TEXCOORDS);
+			glBindTexture(GL_TEXTURE_2D, 0);
+			glDisable(GL_TEXTURE_2D);
+		}
+		break;
+	}
 }
 
 /******************************************************************************
@@ -1510,25 +1398,29 @@ Assignment methods
 ******************************************************************************/
 
 void load_ply(char* ply_path) {
-	FILE* this_file = fopen(ply_path, "r");
+	results.set_source(ply_path); // results already generated for this file are reused
+	size_t len = strlen(ply_path);
+	if (len > 6 && strcmp(ply_path + len - 6, ".boids") == 0) {
+		poly = load_boids(ply_path);
+		if (poly == NULL)
+			throw EXCEPTION_READ_FAULT;
+		return;
+	}
+
+	/* binary so that binary_little_endian files survive the CRT's text mode;
+	   the Polyhedron closes the file once it has read it */
+	FILE* this_file = fopen(ply_path, "rb");
 	if (this_file == NULL)
 		throw EXCEPTION_READ_FAULT;
 	poly = new Polyhedron(this_file);
-	fclose(this_file);
 }
 
 // Scalar fields
 
 void scalar_bounds(Polyhedron* poly, double* lower, double* upper)
 {
-	*lower = poly->vlist[0]->scalar;
-	*upper = poly->vlist[0]->scalar;
-	for (int i = 1; i < poly->nverts; i++) {
-		if (poly->vlist[i]->scalar < *lower)
-			*lower = poly->vlist[i]->scalar;
-		if (poly->vlist[i]->scalar > *upper)
-			*upper = poly->vlist[i]->scalar;
-	}
+	*lower = poly->min_scalar; // found once, when the mesh was loaded
+	*upper = poly->max_scalar;
 }
 
 /*
@@ -1537,31 +1429,6 @@ void scalar_bounds(Polyhedron* poly, double* lower, double* upper)
 * glVertex3d(temp_v->x, temp_v->y, temp_v->z);
 */
 
-/// <summary>
-/// Displays a quadrilateal to the screen, formatted in grayscale by its scalar data
-/// </summary>
-/// <param name="qu">The quadrilateral to display</param>
-/// <param name="lower">The minimum value considered "black", generally taken from the mesh the quad was extracted from</param>
-/// <param name="upper">The maximum value considered "white", generally taken from the mesh the quad was extracted from</param>
-void display_grayscale_quad(Quad* qu, double lower, double upper) {
-	// I could bear to define const color aliases, but for now this will do.
-	float black[3] = { 0, 0, 0 };
-	float white[3] = { 1, 1, 1 };
-	display_bicolor_quad(qu, lower, upper, black, white);
-}
-
-/// <summary>
-/// Displays a quadrilateal to the screen, formatted in pretty colors by its scalar data
-/// </summary>
-/// <param name="qu">The quadrilateral to display</param>
-/// <param name="lower">The minimum value considered "lower_color", generally taken from the mesh the quad was extracted from</param>
-/// <param name="upper">The maximum value considered "upper_color", generally taken from the mesh the quad was extracted from</param>
-/// <param name="lower_color">The color to associate with low scalar values</param>
-/// <param name="upper_color">The color to associate with high scalar values</param>
-void display_bicolor_quad(Quad* qu, double lower, double upper, float lower_color[3], float upper_color[3]) {
-	display_bicolor_heightmod_quad(qu, lower, upper, lower_color, upper_color, 0);
-}
-
 /// <summary>
 /// Displays a quad with its magnitude set in the z direction proportional to the scaler.
 /// </summary>
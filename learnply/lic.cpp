@@ -0,0 +1,297 @@
+/*
+
+Line Integral Convolution on the CPU
+
+*/
+
+#include <math.h>
+#include <stdint.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "polyhedron.h"
+#include "field_sampler.h"
+#include "lic.h"
+#include "noise_hash.h"
+
+/******************************************************************************
+Everything the workers share. The field is sampled once per pixel center
+into unit directions in pixel units, and lines are traced through that
+image rather than the mesh; it's as fine as the output can show anyway.
+******************************************************************************/
+
+struct LicWork {
+	const LicOptions* options;
+	int width, height;
+	std::vector<float> dir_x, dir_y;	/* unit direction at each pixel center, 0 at critical points */
+	std::vector<unsigned char> inside;	/* pixel center is on the mesh */
+	std::vector<float> noise;
+	std::vector<float> sum;				/* filtered values handed to each pixel */
+	std::vector<int> hits;				/* and how many */
+
+	/* sampling pass */
+	const FieldSampler* sampler;
+	double origin[2];
+	double pixel[2];					/* size of a pixel in mesh units */
+
+	int tiles_x, tiles_y;
+	std::atomic<int> next;				/* next row or tile for a worker to take */
+};
+
+/* white noise in [0, 1) as a hash of the pixel, so it needs no shared generator */
+static float noise_value(unsigned int seed, unsigned int index)
+{
+	return (noise_hash(seed, index) >> 8) * (1.0f / 16777216.0f);
+}
+
+static void sample_rows(LicWork* work)
+{
+	int width = work->width;
+	std::vector<double> x(width), y(width), vx(width), vy(width);
+	std::vector<unsigned char> in(width);
+	for (int i = 0; i < width; i++)
+		x[i] = work->origin[0] + (i + 0.5) * work->pixel[0];
+
+	for (int row = work->next++; row < work->height; row = work->next++) {
+		double py = work->origin[1] + (row + 0.5) * work->pixel[1];
+		for (int i = 0; i < width; i++)
+			y[i] = py;
+		work->sampler->sample(x.data(), y.data(), width, vx.data(), vy.data(), in.data());
+
+		size_t base = (size_t)row * width;
+		for (int i = 0; i < width; i++) {
+			/* into pixel units, since that's what the steps are measured in */
+			double dx = vx[i] / work->pixel[0], dy = vy[i] / work->pixel[1];
+			double len = sqrt(dx * dx + dy * dy);
+			work->dir_x[base + i] = len > 0 ? (float)(dx / len) : 0;
+			work->dir_y[base + i] = len > 0 ? (float)(dy / len) : 0;
+			work->inside[base + i] = in[i];
+			work->noise[base + i] = noise_value(work->options->noise_seed, (unsigned int)(base + i));
+		}
+	}
+}
+
+/******************************************************************************
+Direction of the flow at (px, py), in pixels from the lower left corner,
+bilinear between the pixel centers around it.
+
+Exit:
+  returns false off the image, off the mesh or where the field vanishes
+******************************************************************************/
+static bool direction(const LicWork* work, double px, double py, double* dx, double* dy)
+{
+	int width = work->width, height = work->height;
+	if (!(px >= 0 && px < width && py >= 0 && py < height))
+		return false;
+	if (!work->inside[(size_t)(int)py * width + (int)px])
+		return false;
+
+	double fx = px - 0.5, fy = py - 0.5;
+	int i = (int)floor(fx), j = (int)floor(fy);
+	double s = fx - i, t = fy - j;
+	if (i < 0) { i = 0; s = 0; }
+	else if (i > width - 2) { i = width - 2; s = 1; }
+	if (j < 0) { j = 0; t = 0; }
+	else if (j > height - 2) { j = height - 2; t = 1; }
+
+	size_t k = (size_t)j * width + i;
+	const float* ux = work->dir_x.data();
+	const float* uy = work->dir_y.data();
+	double a = ux[k] + s * (ux[k + 1] - ux[k]);
+	double b = ux[k + width] + s * (ux[k + width + 1] - ux[k + width]);
+	double x = a + t * (b - a);
+	a = uy[k] + s * (uy[k + 1] - uy[k]);
+	b = uy[k + width] + s * (uy[k + width + 1] - uy[k + width]);
+	double y = a + t * (b - a);
+
+	double len = sqrt(x * x + y * y);
+	if (len < 1e-6)
+		return false;
+	*dx = x / len;
+	*dy = y / len;
+	return true;
+}
+
+/* one midpoint step; false once the line has to stop */
+static inline bool advance(const LicWork* work, double h, double* px, double* py, int* pixel)
+{
+	double dx, dy, mx, my;
+	if (!direction(work, *px, *py, &dx, &dy) ||
+		!direction(work, *px + 0.5 * h * dx, *py + 0.5 * h * dy, &mx, &my))
+		return false;
+	*px += h * mx;
+	*py += h * my;
+	if (!(*px >= 0 && *px < work->width && *py >= 0 && *py < work->height))
+		return false;
+	*pixel = (int)*py * work->width + (int)*px;
+	return work->inside[*pixel] != 0;
+}
+
+/*
+Traces up to count steps each way from a seed, one pixel index per step.
+Both directions advance in the same loop: each step waits on the one
+before, and two independent lines keep the CPU busy while it does.
+*/
+static void trace_pixels(const LicWork* work, double px, double py, int count,
+	std::vector<int>& forward, std::vector<int>& backward)
+{
+	double h = work->options->step;
+	double fx = px, fy = py, bx = px, by = py;
+	bool ahead = true, behind = true;
+	forward.clear();
+	backward.clear();
+	for (int k = 0; k < count && (ahead || behind); k++) {
+		int p, q;
+		if (ahead && (ahead = advance(work, h, &fx, &fy, &p)))
+			forward.push_back(p);
+		if (behind && (behind = advance(work, -h, &bx, &by, &q)))
+			backward.push_back(q);
+	}
+}
+
+/******************************************************************************
+FastLIC over the tiles. Each seed's line is traced kernel + extension steps
+each way; the box filter then slides along it, and the seed and the
+extension steps on either side all take the filtered value at their step.
+Pixels outside the tile are skipped, so tiles never write to each other's
+pixels and each tile comes out the same whichever thread took it.
+******************************************************************************/
+static void convolve_tiles(LicWork* work)
+{
+	const LicOptions& o = *work->options;
+	int width = work->width;
+	int reach = o.kernel + o.extension;
+	std::vector<int> forward, backward, line;
+
+	int ntiles = work->tiles_x * work->tiles_y;
+	for (int tile = work->next++; tile < ntiles; tile = work->next++) {
+		int x0 = (tile % work->tiles_x) * o.tile, y0 = (tile / work->tiles_x) * o.tile;
+		int x1 = x0 + o.tile < width ? x0 + o.tile : width;
+		int y1 = y0 + o.tile < work->height ? y0 + o.tile : work->height;
+
+		for (int j = y0; j < y1; j++)
+			for (int i = x0; i < x1; i++) {
+				int seed = j * width + i;
+				if (!work->inside[seed] || work->hits[seed] > 0)
+					continue;
+
+				trace_pixels(work, i + 0.5, j + 0.5, reach, forward, backward);
+				line.assign(backward.rbegin(), backward.rend());
+				int center = (int)line.size();
+				line.push_back(seed);
+				line.insert(line.end(), forward.begin(), forward.end());
+
+				int n = (int)line.size();
+				int lo = center - o.extension > 0 ? center - o.extension : 0;
+				int hi = center + o.extension < n - 1 ? center + o.extension : n - 1;
+
+				/* window [k - kernel, k + kernel], cut off where the line ends */
+				int first = lo - o.kernel > 0 ? lo - o.kernel : 0;
+				int last = lo + o.kernel < n - 1 ? lo + o.kernel : n - 1;
+				double total = 0;
+				for (int k = first; k <= last; k++)
+					total += work->noise[line[k]];
+
+				for (int k = lo; k <= hi; k++) {
+					if (k > lo) {
+						if (k + o.kernel < n)
+							total += work->noise[line[++last]];
+						if (k - o.kernel - 1 >= 0)
+							total -= work->noise[line[first++]];
+					}
+					int p = line[k];
+					int px = p % width, py = p / width;
+					if (px < x0 || px >= x1 || py < y0 || py >= y1)
+						continue;
+					work->sum[p] += (float)(total / (last - first + 1));
+					work->hits[p]++;
+				}
+			}
+	}
+}
+
+static void run_workers(void (*worker)(LicWork*), LicWork* work, int nthreads)
+{
+	work->next = 0;
+	std::vector<std::thread> workers;
+	for (int i = 1; i < nthreads; i++)
+		workers.push_back(std::thread(worker, work));
+	worker(work);
+	for (size_t i = 0; i < workers.size(); i++)
+		workers[i].join();
+}
+
+bool compute_lic(Polyhedron* poly, const LicOptions& options, std::vector<unsigned char>& image, int nthreads)
+{
+	if (options.width < 2 || options.height < 2 || options.kernel < 1 || options.extension < 0 ||
+		!(options.step > 0) || options.tile < 1 || poly->nverts == 0)
+		return false;
+
+	poly->calc_bounding_box();
+	if (!(poly->maxx > poly->minx) || !(poly->maxy > poly->miny))
+		return false;
+
+	if (nthreads <= 0)
+		nthreads = (int)std::thread::hardware_concurrency();
+	if (nthreads <= 0)
+		nthreads = 1;
+
+	int width = options.width, height = options.height;
+	size_t npixels = (size_t)width * height;
+	FieldSampler sampler(poly);
+
+	LicWork work;
+	work.options = &options;
+	work.width = width;
+	work.height = height;
+	work.dir_x.resize(npixels);
+	work.dir_y.resize(npixels);
+	work.inside.resize(npixels);
+	work.noise.resize(npixels);
+	work.sum.assign(npixels, 0.0f);
+	work.hits.assign(npixels, 0);
+	work.sampler = &sampler;
+	work.origin[0] = poly->minx;
+	work.origin[1] = poly->miny;
+	work.pixel[0] = (poly->maxx - poly->minx) / width;
+	work.pixel[1] = (poly->maxy - poly->miny) / height;
+	work.tiles_x = (width + options.tile - 1) / options.tile;
+	work.tiles_y = (height + options.tile - 1) / options.tile;
+
+	run_workers(sample_rows, &work, nthreads < height ? nthreads : height);
+	int ntiles = work.tiles_x * work.tiles_y;
+	run_workers(convolve_tiles, &work, nthreads < ntiles ? nthreads : ntiles);
+
+	/* box filtered noise is a narrow band around 0.5; stretch it to the gray range. Where the field
+	   vanishes nothing is smeared and the noise would show through raw, so those pixels are flat gray
+	   and left out of the stretch */
+	double mean = 0, square = 0;
+	size_t count = 0;
+	for (size_t p = 0; p < npixels; p++)
+		if (work.hits[p] && (work.dir_x[p] != 0 || work.dir_y[p] != 0)) {
+			double v = work.sum[p] / work.hits[p];
+			mean += v;
+			square += v * v;
+			count++;
+		}
+	if (count == 0)
+		return false;
+	mean /= count;
+	double deviation = sqrt(fmax(square / count - mean * mean, 0.0));
+	double gain = deviation > 0 ? 48 / deviation : 0;
+
+	image.resize(npixels);
+	for (size_t p = 0; p < npixels; p++) {
+		if (!work.hits[p]) {
+			image[p] = 255;
+			continue;
+		}
+		if (work.dir_x[p] == 0 && work.dir_y[p] == 0) {
+			image[p] = 128;
+			continue;
+		}
+		double gray = 128 + gain * (work.sum[p] / work.hits[p] - mean);
+		image[p] = (unsigned char)(gray < 0 ? 0 : gray > 255 ? 255 : gray + 0.5);
+	}
+	return true;
+}
@@ -0,0 +1,43 @@
+/*
+
+Line Integral Convolution on the CPU
+
+A LIC image smears white noise along the streamlines of the field, so the
+flow shows up densely in one pass rather than settling over many frames as
+IBFV does. This is FastLIC (Stalling and Hege): one long streamline is
+traced per seed pixel, a box filter slides along it, and every pixel the
+line crosses takes the filtered value there, so most pixels are never
+seeds. The image is split into tiles taken by worker threads; a tile's
+lines may run anywhere but only fill in the tile's own pixels.
+
+*/
+
+#ifndef __LIC_H__
+#define __LIC_H__
+
+#include <vector>
+
+class Polyhedron;
+
+/// <summary>
+/// Size of the image and of the filter. Lengths are in steps along a streamline.
+/// </summary>
+struct LicOptions {
+	int width = 1024;
+	int height = 1024;
+	int kernel = 20;		/* half length of the box filter */
+	int extension = 40;		/* steps past the seed, each way, whose filtered values are handed out too */
+	double step = 0.5;		/* in pixels */
+	int tile = 64;			/* tiles are tile x tile pixels */
+	unsigned int noise_seed = 1;
+};
+
+/// <summary>
+/// Computes the LIC of the vector field of poly over its bounding box on nthreads threads (all cores if 0).
+/// The image is options.height rows of options.width gray bytes, bottom row first as OpenGL expects;
+/// pixels off the mesh are white and pixels where the field vanishes mid gray. The result is the same for any number of threads.
+/// </summary>
+/// <returns>False if the options or the mesh leave nothing to draw.</returns>
+bool compute_lic(Polyhedron* poly, const LicOptions& options, std::vector<unsigned char>& image, int nthreads = 0);
+
+#endif /* __LIC_H__ */
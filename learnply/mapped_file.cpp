@@ -0,0 +1,120 @@
+/*
+
+Read-only memory mapping of a whole file
+
+*/
+
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+MappedFile::MappedFile()
+{
+	bytes = NULL;
+	length = 0;
+	file = mapping = NULL;
+	fd = -1;
+}
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const char* path)
+{
+	close();
+
+	HANDLE f = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (f == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(f, &file_size) || (unsigned long long)file_size.QuadPart > (size_t)-1) {
+		CloseHandle(f);
+		return false;
+	}
+	file = f;
+	length = (size_t)file_size.QuadPart;
+	if (length == 0)
+		return true;
+
+	mapping = CreateFileMappingA(f, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping == NULL) {
+		close();
+		return false;
+	}
+	bytes = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (bytes == NULL) {
+		close();
+		return false;
+	}
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (bytes)
+		UnmapViewOfFile(bytes);
+	if (mapping)
+		CloseHandle(mapping);
+	if (file)
+		CloseHandle(file);
+	bytes = NULL;
+	length = 0;
+	file = mapping = NULL;
+}
+
+#else
+
+bool MappedFile::open(const char* path)
+{
+	close();
+
+	fd = ::open(path, O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		close();
+		return false;
+	}
+	length = (size_t)st.st_size;
+	if (length == 0)
+		return true;
+
+	void* view = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (view == MAP_FAILED) {
+		close();
+		return false;
+	}
+	madvise(view, length, MADV_SEQUENTIAL);
+	bytes = (const char*)view;
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (bytes)
+		munmap((void*)bytes, length);
+	if (fd >= 0)
+		::close(fd);
+	bytes = NULL;
+	length = 0;
+	fd = -1;
+}
+
+#endif
@@ -0,0 +1,41 @@
+/*
+
+Read-only memory mapping of a whole file
+
+*/
+
+#ifndef __MAPPED_FILE_H__
+#define __MAPPED_FILE_H__
+
+#include <stddef.h>
+
+/// <summary>
+/// Maps a file into memory for reading. Uses MapViewOfFile on Windows and mmap elsewhere.
+/// </summary>
+class MappedFile {
+public:
+	MappedFile();
+	~MappedFile();
+
+	/// <summary>
+	/// Maps the file at path, unmapping whatever was mapped before.
+	/// </summary>
+	/// <returns>False if the file can't be opened or mapped. An empty file maps successfully with size() == 0.</returns>
+	bool open(const char* path);
+	void close();
+
+	const char* data() const { return bytes; }
+	size_t size() const { return length; }
+
+private:
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+
+	const char* bytes;
+	size_t length;
+	void* file;		/* file and mapping handles on Windows */
+	void* mapping;
+	int fd;			/* file descriptor elsewhere */
+};
+
+#endif /* __MAPPED_FILE_H__ */
@@ -0,0 +1,169 @@
+/*
+
+Retained-mode drawing of a Polyhedron
+
+*/
+
+#include <string.h>
+#include "polyhedron.h"
+#include "mesh_renderer.h"
+
+MeshRenderer::MeshRenderer()
+	: poly(NULL), built(false), use_buffers(false), scalar_current(false)
+{
+	memset(buffers, 0, sizeof(buffers));
+}
+
+void MeshRenderer::set_mesh(Polyhedron* poly)
+{
+	if (poly == this->poly && built)
+		return;
+	this->poly = poly;
+	build();
+}
+
+void MeshRenderer::invalidate()
+{
+	built = false;
+}
+
+void MeshRenderer::upload(int slot, GLenum target, const void* data, size_t bytes)
+{
+	glBindBuffer(target, buffers[slot]);
+	glBufferData(target, bytes, data, GL_STATIC_DRAW);
+	glBindBuffer(target, 0);
+}
+
+/******************************************************************************
+Copies everything the draws need out of the mesh, in float since that's
+all the rasterizer keeps, and hands it to the driver if it takes buffers.
+The scalar colors wait for set_color_map.
+******************************************************************************/
+void MeshRenderer::build()
+{
+	const VertexAttributes& attr = poly->attributes;
+	int n = attr.size();
+
+	positions.resize(3 * (size_t)n);
+	normals.resize(3 * (size_t)n);
+	colors.resize(3 * (size_t)n);
+	scalar_colors.assign(4 * (size_t)n, 0);
+	texcoords.resize(2 * (size_t)n);
+
+	poly->calc_bounding_box();
+	double sx = poly->maxx > poly->minx ? 1 / (poly->maxx - poly->minx) : 0;
+	double sy = poly->maxy > poly->miny ? 1 / (poly->maxy - poly->miny) : 0;
+	for (int i = 0; i < n; i++) {
+		positions[3 * i] = (float)attr.x[i];
+		positions[3 * i + 1] = (float)attr.y[i];
+		positions[3 * i + 2] = (float)attr.z[i];
+		for (int k = 0; k < 3; k++)
+			normals[3 * i + k] = (float)poly->vlist[i]->normal.entry[k];
+		colors[3 * i] = attr.R[i];
+		colors[3 * i + 1] = attr.G[i];
+		colors[3 * i + 2] = attr.B[i];
+		texcoords[2 * i] = (float)((attr.x[i] - poly->minx) * sx);
+		texcoords[2 * i + 1] = (float)((attr.y[i] - poly->miny) * sy);
+	}
+
+	/* GL_QUADS may be split along the other diagonal, which shades differently than the old per quad polygons */
+	static const int fan[6] = { 0, 1, 2, 0, 2, 3 };
+	triangles.resize(6 * (size_t)poly->nquads);
+	quads.resize(4 * (size_t)poly->nquads);
+	for (int i = 0; i < poly->nquads; i++) {
+		Quad* q = poly->qlist[i];
+		for (int j = 0; j < 6; j++)
+			triangles[6 * (size_t)i + j] = q->verts[fan[j]]->index;
+		for (int j = 0; j < 4; j++)
+			quads[4 * (size_t)i + j] = q->verts[j]->index;
+	}
+
+	use_buffers = GLEW_VERSION_1_5 != 0;
+	if (use_buffers) {
+		if (buffers[0] == 0)
+			glGenBuffers(SLOTS, buffers);
+		upload(POSITIONS, GL_ARRAY_BUFFER, positions.data(), positions.size() * sizeof(float));
+		upload(NORMALS, GL_ARRAY_BUFFER, normals.data(), normals.size() * sizeof(float));
+		upload(COLORS, GL_ARRAY_BUFFER, colors.data(), colors.size() * sizeof(float));
+		upload(SCALAR_COLORS, GL_ARRAY_BUFFER, scalar_colors.data(), scalar_colors.size());
+		upload(TEXCOORDS, GL_ARRAY_BUFFER, texcoords.data(), texcoords.size() * sizeof(float));
+		upload(TRIANGLES, GL_ELEMENT_ARRAY_BUFFER, triangles.data(), triangles.size() * sizeof(GLuint));
+		upload(QUADS, GL_ELEMENT_ARRAY_BUFFER, quads.data(), quads.size() * sizeof(GLuint));
+	}
+
+	scalar_current = false;
+	built = true;
+}
+
+void MeshRenderer::set_color_map(const ColorMap& map)
+{
+	if (!built || (scalar_current && map == color_map))
+		return;
+
+	map.apply(poly->attributes.scalar.data(), poly->attributes.size(), scalar_colors);
+	if (use_buffers)
+		upload(SCALAR_COLORS, GL_ARRAY_BUFFER, scalar_colors.data(), scalar_colors.size());
+
+	color_map = map;
+	scalar_current = true;
+}
+
+void MeshRenderer::draw(int flags)
+{
+	if (!built || quads.empty())
+		return;
+
+	/* with buffers the pointers are offsets into the bound buffer, without them addresses */
+	glEnableClientState(GL_VERTEX_ARRAY);
+	if (use_buffers)
+		glBindBuffer(GL_ARRAY_BUFFER, buffers[POSITIONS]);
+	glVertexPointer(3, GL_FLOAT, 0, use_buffers ? 0 : positions.data());
+
+	if (flags & MESH_NORMALS) {
+		glEnableClientState(GL_NORMAL_ARRAY);
+		if (use_buffers)
+			glBindBuffer(GL_ARRAY_BUFFER, buffers[NORMALS]);
+		glNormalPointer(GL_FLOAT, 0, use_buffers ? 0 : normals.data());
+	}
+	if (flags & MESH_SCALAR_COLORS) {
+		glEnableClientState(GL_COLOR_ARRAY);
+		if (use_buffers)
+			glBindBuffer(GL_ARRAY_BUFFER, buffers[SCALAR_COLORS]);
+		glColorPointer(4, GL_UNSIGNED_BYTE, 0, use_buffers ? 0 : scalar_colors.data());
+	}
+	else if (flags & MESH_VERTEX_COLORS) {
+		glEnableClientState(GL_COLOR_ARRAY);
+		if (use_buffers)
+			glBindBuffer(GL_ARRAY_BUFFER, buffers[COLORS]);
+		glColorPointer(3, GL_FLOAT, 0, use_buffers ? 0 : colors.data());
+	}
+	if (flags & MESH_TEXCOORDS) {
+		glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+		if (use_buffers)
+			glBindBuffer(GL_ARRAY_BUFFER, buffers[TEXCOORDS]);
+		glTexCoordPointer(2, GL_FLOAT, 0, use_buffers ? 0 : texcoords.data());
+	}
+
+	const std::vector<GLuint>& indices = flags & MESH_OUTLINES ? quads : triangles;
+	if (use_buffers)
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[flags & MESH_OUTLINES ? QUADS : TRIANGLES]);
+	glDrawElements(flags & MESH_OUTLINES ? GL_QUADS : GL_TRIANGLES, (GLsizei)indices.size(), GL_UNSIGNED_INT,
+		use_buffers ? 0 : indices.data());
+
+	if (use_buffers) {
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+	glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+	glDisableClientState(GL_COLOR_ARRAY);
+	glDisableClientState(GL_NORMAL_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
+}
+
+void MeshRenderer::release()
+{
+	if (buffers[0] != 0)
+		glDeleteBuffers(SLOTS, buffers);
+	memset(buffers, 0, sizeof(buffers));
+	built = false;
+}
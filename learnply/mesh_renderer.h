@@ -0,0 +1,87 @@
+/*
+
+Retained-mode drawing of a Polyhedron
+
+The quads of a mesh go to OpenGL once, as vertex, normal, color and
+texture coordinate arrays with index buffers, and each frame draws them
+with a single glDrawElements instead of a glBegin/glEnd per quad. The
+arrays live in buffer objects where the driver has them (OpenGL 1.5) and
+are drawn from client memory otherwise.
+
+*/
+
+#ifndef __MESH_RENDERER_H__
+#define __MESH_RENDERER_H__
+
+#include <vector>
+#include "gl/glew.h"
+#include "color_map.h"
+
+class Polyhedron;
+
+/// <summary>
+/// Per-vertex arrays a draw can use. Whatever isn't asked for comes from the current OpenGL state.
+/// </summary>
+enum MeshArrays {
+	MESH_NORMALS = 1,		/* vertex normals, for lit drawing */
+	MESH_VERTEX_COLORS = 2,	/* the R, G, B of each vertex */
+	MESH_SCALAR_COLORS = 4,	/* the scalar field through a ColorMap, see set_color_map */
+	MESH_TEXCOORDS = 8,		/* position scaled into the bounding box, [0, 1] on each side */
+	MESH_OUTLINES = 16,		/* the quads rather than their triangles, so GL_LINE polygon mode shows no diagonals */
+};
+
+class MeshRenderer {
+public:
+	MeshRenderer();
+
+	/// <summary>
+	/// Makes poly the mesh to draw, building its arrays if it isn't the mesh they were built for.
+	/// A mesh replaced by another at the same address needs invalidate() as well.
+	/// </summary>
+	void set_mesh(Polyhedron* poly);
+
+	/// <summary>
+	/// Rebuilds everything on the next set_mesh, after the mesh or its vertex colors changed.
+	/// </summary>
+	void invalidate();
+
+	/// <summary>
+	/// Colors for MESH_SCALAR_COLORS. They are only mapped again when map differs from the last call or the mesh changed,
+	/// so calling this every frame costs a comparison.
+	/// </summary>
+	void set_color_map(const ColorMap& map);
+
+	/// <summary>
+	/// Draws every quad of the mesh with the arrays in flags, a combination of MeshArrays.
+	/// </summary>
+	void draw(int flags);
+
+	/// <summary>
+	/// Frees the buffer objects. Needs the OpenGL context they were made in.
+	/// </summary>
+	void release();
+
+private:
+	MeshRenderer(const MeshRenderer&);
+	MeshRenderer& operator=(const MeshRenderer&);
+
+	void build();
+	void upload(int slot, GLenum target, const void* data, size_t bytes);
+
+	enum { POSITIONS, NORMALS, COLORS, SCALAR_COLORS, TEXCOORDS, TRIANGLES, QUADS, SLOTS };
+
+	Polyhedron* poly;
+	bool built;
+	bool use_buffers;
+	GLuint buffers[SLOTS];
+
+	std::vector<float> positions, normals, colors, texcoords;
+	std::vector<unsigned char> scalar_colors;	/* RGBA8 */
+	std::vector<GLuint> triangles;	/* each quad split 0 1 2, 0 2 3, as OpenGL splits a GL_POLYGON */
+	std::vector<GLuint> quads;
+
+	ColorMap color_map;		/* the map scalar_colors were made with */
+	bool scalar_current;
+};
+
+#endif /* __MESH_RENDERER_H__ */
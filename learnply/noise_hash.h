@@ -0,0 +1,30 @@
+/*
+
+Hashed noise
+
+A noise value as an integer hash of a seed and an index rather than the
+next number of a generator, so noise can be made in any order, on any
+number of threads, and still come out the same.
+
+*/
+
+#ifndef __NOISE_HASH_H__
+#define __NOISE_HASH_H__
+
+#include <stdint.h>
+
+/// <summary>
+/// 32 well mixed bits for index under seed.
+/// </summary>
+inline uint32_t noise_hash(unsigned int seed, unsigned int index)
+{
+	uint32_t h = index * 0x9E3779B1u ^ seed * 0x85EBCA77u;
+	h ^= h >> 15;
+	h *= 0x2C1B3C6Du;
+	h ^= h >> 12;
+	h *= 0x297A2D39u;
+	h ^= h >> 15;
+	return h;
+}
+
+#endif /* __NOISE_HASH_H__ */
@@ -0,0 +1,294 @@
+/*
+
+Pathlines and streaklines through a time series of fields
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <algorithm>
+#include "polyhedron.h"
+#include "topo_cache.h"
+#include "field_sampler.h"
+#include "pathline.h"
+
+bool slice_time_from_name(const char* path, double* time)
+{
+	const char* suffix = ".boids.ply";
+	size_t len = strlen(path), slen = strlen(suffix);
+	if (len < slen || strcmp(path + len - slen, suffix) != 0)
+		return false;
+
+	size_t end = len - slen, start = end;
+	while (start > 0 && (isdigit((unsigned char)path[start - 1]) || path[start - 1] == '.'))
+		start--;
+	if (start == end)
+		return false;
+	*time = atof(std::string(path + start, end - start).c_str());
+	return true;
+}
+
+static bool earlier(const FieldSlice& a, const FieldSlice& b)
+{
+	return a.time < b.time;
+}
+
+TimeVaryingField::TimeVaryingField(const std::vector<FieldSlice>& slices)
+{
+	this->slices = slices;
+	std::stable_sort(this->slices.begin(), this->slices.end(), earlier);
+	lower = -1;
+	resident[0] = resident[1] = NULL;
+	load_count = 0;
+}
+
+TimeVaryingField::~TimeVaryingField()
+{
+	release(resident[0]);
+	release(resident[1]);
+}
+
+Polyhedron* TimeVaryingField::load(int slice)
+{
+	const char* path = slices[slice].path.c_str();
+	FILE* file = fopen(path, "rb");
+	if (file == NULL) {
+		fprintf(stderr, "Could not open %s.\n", path);
+		return NULL;
+	}
+	/* the Polyhedron closes the file once it has read it */
+	Polyhedron* poly = new Polyhedron(file);
+	initialize_cached(poly, path);
+	load_count++;
+	return poly;
+}
+
+void TimeVaryingField::release(Polyhedron* poly)
+{
+	if (poly) {
+		poly->finalize();
+		delete poly;
+	}
+}
+
+/******************************************************************************
+Make the slices around t resident. Moving on by one slice keeps the upper
+one as the new lower one, so a forward sweep reads each slice once.
+******************************************************************************/
+
+bool TimeVaryingField::seek(double t)
+{
+	int n = (int)slices.size();
+	if (n == 0 || !(t >= slices[0].time && t <= slices[n - 1].time))
+		return false;
+
+	/* a single slice is a steady field */
+	int want = 0;
+	while (want + 2 < n && t > slices[want + 1].time)
+		want++;
+	if (want == lower)
+		return resident[0] != NULL;
+
+	if (lower >= 0 && want == lower + 1 && n > 1) {
+		release(resident[0]);
+		resident[0] = resident[1];
+		resident[1] = NULL;
+	}
+	else {
+		release(resident[0]);
+		release(resident[1]);
+		resident[0] = resident[1] = NULL;
+	}
+	lower = want;
+
+	if (!resident[0])
+		resident[0] = load(want);
+	if (!resident[1] && want + 1 < n)
+		resident[1] = load(want + 1);
+	return resident[0] != NULL && (want + 1 >= n || resident[1] != NULL);
+}
+
+bool TimeVaryingField::sample(const double* x, const double* y, int n, double t, double* vx, double* vy, unsigned char* inside)
+{
+	if (!seek(t))
+		return false;
+
+	FieldSampler(resident[0]).sample(x, y, n, vx, vy, inside);
+	if (!resident[1])
+		return true;
+
+	double t0 = slices[lower].time, t1 = slices[lower + 1].time;
+	double w = t1 > t0 ? (t - t0) / (t1 - t0) : 0;
+	if (w <= 0)
+		return true;
+
+	upper_vx.resize(n);
+	upper_vy.resize(n);
+	upper_inside.resize(n);
+	FieldSampler(resident[1]).sample(x, y, n, upper_vx.data(), upper_vy.data(), upper_inside.data());
+	for (int i = 0; i < n; i++) {
+		vx[i] += w * (upper_vx[i] - vx[i]);
+		vy[i] += w * (upper_vy[i] - vy[i]);
+	}
+	if (inside)
+		for (int i = 0; i < n; i++)
+			inside[i] &= upper_inside[i];
+	return true;
+}
+
+ParticleTracer::ParticleTracer(TimeVaryingField* field)
+{
+	this->field = field;
+}
+
+/******************************************************************************
+One classic RK4 step for all live particles at once. Stage times only ever
+go forward, so the field never has to reload a slice it has passed.
+******************************************************************************/
+
+bool ParticleTracer::step(double t, double h)
+{
+	live.clear();
+	for (int i = 0; i < (int)alive.size(); i++)
+		if (alive[i])
+			live.push_back(i);
+	int n = (int)live.size();
+	if (n == 0)
+		return true;
+
+	px.resize(n);
+	py.resize(n);
+	sx.resize(n);
+	sy.resize(n);
+	inside.resize(n);
+	for (int j = 0; j < 4; j++) {
+		kx[j].resize(n);
+		ky[j].resize(n);
+	}
+	for (int i = 0; i < n; i++) {
+		px[i] = x[live[i]];
+		py[i] = y[live[i]];
+	}
+
+	/* stage j is sampled at p + c[j] h k[j - 1], at time t + c[j] h */
+	static const double c[4] = { 0, 0.5, 0.5, 1 };
+	for (int j = 0; j < 4; j++) {
+		const double* qx = px.data();
+		const double* qy = py.data();
+		if (j > 0) {
+			for (int i = 0; i < n; i++) {
+				sx[i] = px[i] + c[j] * h * kx[j - 1][i];
+				sy[i] = py[i] + c[j] * h * ky[j - 1][i];
+			}
+			qx = sx.data();
+			qy = sy.data();
+		}
+		if (!field->sample(qx, qy, n, t + c[j] * h, kx[j].data(), ky[j].data(), inside.data()))
+			return false;
+		for (int i = 0; i < n; i++)
+			if (!inside[i])
+				alive[live[i]] = 0;
+	}
+
+	for (int i = 0; i < n; i++) {
+		int k = live[i];
+		if (!alive[k])
+			continue;
+		double nx = px[i] + h * (kx[0][i] + 2 * kx[1][i] + 2 * kx[2][i] + kx[3][i]) / 6;
+		double ny = py[i] + h * (ky[0][i] + 2 * ky[1][i] + 2 * ky[2][i] + ky[3][i]) / 6;
+		x[k] = nx;
+		y[k] = ny;
+	}
+
+	/* the end point has to be in the mesh too, or the next step would start outside it */
+	for (int i = 0; i < n; i++) {
+		sx[i] = x[live[i]];
+		sy[i] = y[live[i]];
+	}
+	if (!field->sample(sx.data(), sy.data(), n, t + h, kx[0].data(), ky[0].data(), inside.data()))
+		return false;
+	for (int i = 0; i < n; i++)
+		if (!inside[i])
+			alive[live[i]] = 0;
+	return true;
+}
+
+bool ParticleTracer::trace_pathlines(const std::vector<icVector3>& seeds, double t0, double t1, double dt, StreamlineStore& store)
+{
+	store.clear();
+	int nseeds = (int)seeds.size();
+	x.resize(nseeds);
+	y.resize(nseeds);
+	alive.assign(nseeds, 1);
+	for (int i = 0; i < nseeds; i++) {
+		x[i] = seeds[i].x;
+		y[i] = seeds[i].y;
+	}
+
+	std::vector<PolyLine> paths(nseeds);
+	std::vector<double> last_x, last_y;
+	for (double t = t0; t < t1 && dt > 0; t += dt) {
+		double h = fmin(dt, t1 - t);
+		last_x = x;
+		last_y = y;
+		if (!step(t, h))
+			return false;
+		for (int i = 0; i < nseeds; i++)
+			if (alive[i])
+				paths[i].push_back(LineSegment(last_x[i], last_y[i], seeds[i].z, x[i], y[i], seeds[i].z));
+	}
+
+	for (int i = 0; i < nseeds; i++)
+		store.append(paths[i]);
+	return true;
+}
+
+bool ParticleTracer::trace_streaklines(const std::vector<icVector3>& seeds, double t0, double t1, double dt, StreamlineStore& store,
+	std::vector<int>* first_line)
+{
+	store.clear();
+	if (first_line)
+		first_line->clear();
+	int nseeds = (int)seeds.size();
+	x.clear();
+	y.clear();
+	alive.clear();
+
+	/* particle k * nseeds + i is the k-th one released from seed i; the particles already out move before the
+	   next ones are released, so the last ones are still at the seeds at t1 */
+	int releases = 0;
+	for (double t = t0;; t += dt) {
+		for (int i = 0; i < nseeds; i++) {
+			x.push_back(seeds[i].x);
+			y.push_back(seeds[i].y);
+			alive.push_back(1);
+		}
+		releases++;
+		if (!(t < t1 && dt > 0))
+			break;
+		if (!step(t, fmin(dt, t1 - t)))
+			return false;
+	}
+
+	PolyLine streak;
+	for (int i = 0; i < nseeds; i++) {
+		if (first_line)
+			first_line->push_back(store.size());
+		streak.clear();
+		double z = seeds[i].z;
+		int newer = -1;
+		for (int k = releases - 1; k >= 0; k--) {
+			int p = k * nseeds + i;
+			if (alive[p] && newer >= 0)
+				streak.push_back(LineSegment(x[newer], y[newer], z, x[p], y[p], z));
+			newer = alive[p] ? p : -1;
+		}
+		store.append(streak);
+	}
+	if (first_line)
+		first_line->push_back(store.size());
+	return true;
+}
@@ -0,0 +1,112 @@
+/*
+
+Pathlines and streaklines through a time series of fields
+
+The proc_boids_ts files are one flow seen at growing time horizons. The
+TimeVaryingField treats them as samples in time and blends the two slices
+either side of the time asked for. Only those two are ever loaded: the
+tracers move every particle forward together, a step at a time, so each
+slice is read once, when the tracers reach it, and dropped once they pass.
+
+*/
+
+#ifndef __PATHLINE_H__
+#define __PATHLINE_H__
+
+#include <string>
+#include <vector>
+#include "icVector.H"
+#include "streamline.h"
+
+class Polyhedron;
+
+/// <summary>
+/// One file of a time series and the time it shows.
+/// </summary>
+struct FieldSlice {
+	double time;
+	std::string path;
+};
+
+/// <summary>
+/// The time of a slice from its file name, the number just before ".boids.ply" as -slice names them,
+/// e.g. 16 for "long16.boids.ply". False if there's no number, as for the whole-log file.
+/// </summary>
+bool slice_time_from_name(const char* path, double* time);
+
+/// <summary>
+/// A vector field that varies in time, linearly between slices. Not thread safe.
+/// </summary>
+class TimeVaryingField {
+public:
+	/// <summary>
+	/// The slices may come in any order; they are sorted by time. Nothing is loaded until the first sample.
+	/// </summary>
+	TimeVaryingField(const std::vector<FieldSlice>& slices);
+	~TimeVaryingField();
+
+	double start_time() const { return slices.front().time; }
+	double end_time() const { return slices.back().time; }
+
+	/// <summary>
+	/// Samples the field at time t at n points, like FieldSampler::sample. Loads the slices around t if they
+	/// aren't the ones already loaded; that's cheap for t moving forward a little, but a slice read for anything else.
+	/// </summary>
+	/// <returns>False if t is outside the series or a slice can't be read.</returns>
+	bool sample(const double* x, const double* y, int n, double t, double* vx, double* vy, unsigned char* inside = 0);
+
+	/// <summary>
+	/// How many slices have been read from disk so far.
+	/// </summary>
+	int loads() const { return load_count; }
+
+private:
+	std::vector<FieldSlice> slices;
+	int lower;					/* resident[0] is slices[lower], resident[1] is slices[lower + 1] */
+	Polyhedron* resident[2];
+	int load_count;
+
+	/* scratch for the upper slice's samples */
+	std::vector<double> upper_vx, upper_vy;
+	std::vector<unsigned char> upper_inside;
+
+	bool seek(double t);
+	Polyhedron* load(int slice);
+	static void release(Polyhedron* poly);
+};
+
+/// <summary>
+/// Traces particles released at seeds through a TimeVaryingField with RK4 steps of dt, forward from t0 to t1.
+/// </summary>
+class ParticleTracer {
+public:
+	ParticleTracer(TimeVaryingField* field);
+
+	/// <summary>
+	/// Line i of store is the path of a particle released at seeds[i] at t0, up to t1 or until it leaves the mesh.
+	/// </summary>
+	bool trace_pathlines(const std::vector<icVector3>& seeds, double t0, double t1, double dt, StreamlineStore& store);
+
+	/// <summary>
+	/// Every step, each seed releases a new particle. The particles of each seed at t1 are joined newest (at the seed)
+	/// to oldest into one or more lines, split wherever a particle left the mesh, and the lines come in seed order.
+	/// If first_line isn't NULL, the lines of seeds[i] are [(*first_line)[i], (*first_line)[i + 1]) of store.
+	/// </summary>
+	bool trace_streaklines(const std::vector<icVector3>& seeds, double t0, double t1, double dt, StreamlineStore& store,
+		std::vector<int>* first_line = NULL);
+
+private:
+	TimeVaryingField* field;
+	std::vector<double> x, y;			/* every particle released so far */
+	std::vector<unsigned char> alive;
+
+	/* scratch for the live particles during a step */
+	std::vector<int> live;
+	std::vector<double> px, py, sx, sy, kx[4], ky[4];
+	std::vector<unsigned char> inside;
+
+	/* moves every live particle from t to t + h; particles that leave the mesh die */
+	bool step(double t, double h);
+};
+
+#endif /* __PATHLINE_H__ */
@@ -1739,7 +1739,7 @@ char **get_words(FILE *fp, int *nwords, char **orig_line)
 
   for (ptr = str, ptr2 = str_copy; *ptr != '\0'; ptr++, ptr2++) {
     *ptr2 = *ptr;
-    if (*ptr == '\t') {
+    if (*ptr == '\t' || *ptr == '\r') {   /* '\r' shows up in DOS files opened "rb" */
       *ptr = ' ';
       *ptr2 = ' ';
     }
@@ -2621,11 +2621,18 @@ Close a PLY file.
 
 Entry:
   plyfile - identifier of file to close
+
+Exit:
+  returns 0, or EOF if writing or closing the file failed
 ******************************************************************************/
 
-void close_ply(PlyFile *plyfile)
+int close_ply(PlyFile *plyfile)
 {
-  fclose (plyfile->fp);
+  int error = ferror (plyfile->fp);
+
+  if (fclose (plyfile->fp) != 0 || error)
+    return (EOF);
+  return (0);
 }
 
 
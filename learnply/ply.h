@@ -181,7 +181,7 @@ PlyOtherElems *get_other_element_ply (PlyFile *);
 PlyFile *read_ply(FILE *);
 PlyFile *write_ply(FILE *, int, char **, int);
 extern PlyFile *open_for_writing_ply(char *, int, char **, int);
-void close_ply(PlyFile *);
+int close_ply(PlyFile *);
 void free_ply(PlyFile *);
 
 void get_info_ply(PlyFile *, float *, int *);
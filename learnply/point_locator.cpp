@@ -0,0 +1,264 @@
+/*
+
+Point location for field queries
+
+*/
+
+#include <math.h>
+#include <float.h>
+#include "polyhedron.h"
+#include "structured_grid.h"
+#include "point_locator.h"
+
+/* how far outside [0, 1] a bilinear coordinate may be and still count as inside, for points on shared edges */
+static const double INSIDE_TOLERANCE = 1.0e-9;
+
+/* quads a walk may cross before it gives up and locates from scratch */
+static const int MAX_WALK = 8;
+
+static int clamp_bucket(double f, int n)
+{
+	if (!(f > 0))
+		return 0;
+	if (f >= n - 1)
+		return n - 1;
+	return (int)f;
+}
+
+PointLocator::PointLocator(Polyhedron* poly)
+{
+	this->poly = poly;
+	origin[0] = origin[1] = 0;
+	bucket_size[0] = bucket_size[1] = 1;
+	nbuckets[0] = nbuckets[1] = 0;
+
+	int nquads = poly->nquads;
+	if (poly->grid || nquads == 0)
+		return;
+
+	boxes.resize(4 * (size_t)nquads);
+	double minx = DBL_MAX, miny = DBL_MAX, maxx = -DBL_MAX, maxy = -DBL_MAX;
+	for (int i = 0; i < nquads; i++) {
+		Vertex** verts = poly->qlist[i]->verts;
+		double* box = &boxes[4 * (size_t)i];
+		box[0] = box[2] = verts[0]->x;
+		box[1] = box[3] = verts[0]->y;
+		for (int j = 1; j < 4; j++) {
+			box[0] = fmin(box[0], verts[j]->x);
+			box[1] = fmin(box[1], verts[j]->y);
+			box[2] = fmax(box[2], verts[j]->x);
+			box[3] = fmax(box[3], verts[j]->y);
+		}
+		minx = fmin(minx, box[0]);
+		miny = fmin(miny, box[1]);
+		maxx = fmax(maxx, box[2]);
+		maxy = fmax(maxy, box[3]);
+	}
+
+	/* about one quad per bucket, with buckets as square as the mesh allows */
+	double w = maxx - minx;
+	double h = maxy - miny;
+	if (w > 0 && h > 0) {
+		nbuckets[0] = (int)ceil(sqrt(nquads * w / h));
+		nbuckets[1] = (int)ceil(nquads / (double)nbuckets[0]);
+	}
+	else if (w > 0) {
+		nbuckets[0] = nquads;
+		nbuckets[1] = 1;
+	}
+	else {
+		nbuckets[0] = 1;
+		nbuckets[1] = h > 0 ? nquads : 1;
+	}
+	origin[0] = minx;
+	origin[1] = miny;
+	bucket_size[0] = w > 0 ? w / nbuckets[0] : 1;
+	bucket_size[1] = h > 0 ? h / nbuckets[1] : 1;
+
+	/* count, prefix sum, then fill; every quad goes in each bucket its box touches */
+	int nb = nbuckets[0] * nbuckets[1];
+	first.assign(nb + 1, 0);
+	for (int pass = 0; pass < 2; pass++) {
+		if (pass == 1) {
+			for (int b = 0; b < nb; b++)
+				first[b + 1] += first[b];
+			items.resize(first[nb]);
+		}
+		for (int i = 0; i < nquads; i++) {
+			const double* box = &boxes[4 * (size_t)i];
+			int x0 = clamp_bucket((box[0] - origin[0]) / bucket_size[0], nbuckets[0]);
+			int y0 = clamp_bucket((box[1] - origin[1]) / bucket_size[1], nbuckets[1]);
+			int x1 = clamp_bucket((box[2] - origin[0]) / bucket_size[0], nbuckets[0]);
+			int y1 = clamp_bucket((box[3] - origin[1]) / bucket_size[1], nbuckets[1]);
+			for (int by = y0; by <= y1; by++)
+				for (int bx = x0; bx <= x1; bx++) {
+					int b = by * nbuckets[0] + bx;
+					if (pass == 0)
+						first[b + 1]++;
+					else
+						items[first[b]++] = i;
+				}
+		}
+	}
+	/* the fill advanced each start to the next bucket's; shift them back */
+	for (int b = nb; b > 0; b--)
+		first[b] = first[b - 1];
+	first[0] = 0;
+}
+
+/******************************************************************************
+Invert the bilinear map of a quad, i.e. solve p = p0 + s e + t f + s t g
+where e = p1 - p0, f = p3 - p0 and g = p0 - p1 + p2 - p3. Crossing both
+sides with e + t g leaves a quadratic in t. Of its roots, the one whose
+(s, t) is closest to the unit square is kept, so a point just outside the
+quad still says which side it's past.
+******************************************************************************/
+
+bool PointLocator::coordinates(int quad, double x, double y, double* s, double* t) const
+{
+	Vertex** verts = poly->qlist[quad]->verts;
+	double ex = verts[1]->x - verts[0]->x, ey = verts[1]->y - verts[0]->y;
+	double fx = verts[3]->x - verts[0]->x, fy = verts[3]->y - verts[0]->y;
+	double gx = verts[0]->x - verts[1]->x + verts[2]->x - verts[3]->x;
+	double gy = verts[0]->y - verts[1]->y + verts[2]->y - verts[3]->y;
+	double hx = x - verts[0]->x, hy = y - verts[0]->y;
+
+	double k2 = gx * fy - gy * fx;
+	double k1 = ex * fy - ey * fx + hx * gy - hy * gx;
+	double k0 = hx * ey - hy * ex;
+
+	double roots[2];
+	int nroots;
+	if (fabs(k2) <= 1.0e-12 * fabs(k1)) {
+		/* parallelograms and anything close to one */
+		if (k1 == 0)
+			return false;
+		roots[0] = -k0 / k1;
+		nroots = 1;
+	}
+	else {
+		double d = k1 * k1 - 4 * k0 * k2;
+		if (d < 0)
+			return false;
+		/* the form without cancellation, since nearly-parallelogram quads make k2 tiny */
+		double q = -0.5 * (k1 + (k1 < 0 ? -sqrt(d) : sqrt(d)));
+		roots[0] = q / k2;
+		roots[1] = q != 0 ? k0 / q : roots[0];
+		nroots = 2;
+	}
+
+	double best = DBL_MAX;
+	for (int i = 0; i < nroots; i++) {
+		double v = roots[i];
+		/* s from whichever component of e + v g is better conditioned */
+		double dx = ex + gx * v, dy = ey + gy * v;
+		double u;
+		if (fabs(dx) >= fabs(dy) && dx != 0)
+			u = (hx - fx * v) / dx;
+		else if (dy != 0)
+			u = (hy - fy * v) / dy;
+		else
+			continue;
+		double miss = fmax(fmax(-u, u - 1), fmax(-v, v - 1));
+		if (miss < best) {
+			best = miss;
+			*s = u;
+			*t = v;
+		}
+	}
+	return best != DBL_MAX;
+}
+
+bool PointLocator::inside(int quad, double x, double y, double* s, double* t) const
+{
+	double u, v;
+	const double lo = -INSIDE_TOLERANCE, hi = 1 + INSIDE_TOLERANCE;
+	if (!coordinates(quad, x, y, &u, &v) || !(u >= lo && u <= hi && v >= lo && v <= hi))
+		return false;
+	*s = fmin(fmax(u, 0.0), 1.0);
+	*t = fmin(fmax(v, 0.0), 1.0);
+	return true;
+}
+
+int PointLocator::neighbor(int quad, int side) const
+{
+	if (poly->grid)
+		return poly->grid->cell_neighbor(quad, side);
+
+	Quad* q = poly->qlist[quad];
+	Edge* e = q->edges[side];
+	if (!e)
+		return -1;
+	Quad* other = poly->other_quad(e, q);
+	return other ? other->index : -1;
+}
+
+/******************************************************************************
+Step from quad to quad towards the point, each time across the side the
+point is furthest past. A short hop normally ends it; running into the
+boundary or going round in circles (non-convex quads, holes in the mesh)
+falls back to a full locate.
+******************************************************************************/
+
+bool PointLocator::walk(double x, double y, int* quad, double* s, double* t) const
+{
+	if (poly->grid || *quad < 0 || *quad >= poly->nquads)
+		return locate(x, y, quad, s, t);
+
+	int q = *quad;
+	for (int hop = 0; hop < MAX_WALK; hop++) {
+		double u, v;
+		if (!coordinates(q, x, y, &u, &v))
+			break;
+
+		const double lo = -INSIDE_TOLERANCE, hi = 1 + INSIDE_TOLERANCE;
+		if (u >= lo && u <= hi && v >= lo && v <= hi) {
+			*quad = q;
+			*s = fmin(fmax(u, 0.0), 1.0);
+			*t = fmin(fmax(v, 0.0), 1.0);
+			return true;
+		}
+
+		/* side j runs from verts[j] to verts[j + 1] */
+		double past[4] = { -v, u - 1, v - 1, -u };
+		int side = 0;
+		for (int j = 1; j < 4; j++)
+			if (past[j] > past[side])
+				side = j;
+
+		q = neighbor(q, side);
+		if (q < 0)
+			break;
+	}
+
+	if (!locate(x, y, &q, s, t))
+		return false;
+	*quad = q;
+	return true;
+}
+
+bool PointLocator::locate(double x, double y, int* quad, double* s, double* t) const
+{
+	if (poly->grid)
+		return poly->grid->locate(x, y, quad, s, t);
+
+	if (first.empty())
+		return false;
+	double fx = (x - origin[0]) / bucket_size[0];
+	double fy = (y - origin[1]) / bucket_size[1];
+	if (!(fx >= 0 && fx <= nbuckets[0] && fy >= 0 && fy <= nbuckets[1]))
+		return false;
+
+	int b = clamp_bucket(fy, nbuckets[1]) * nbuckets[0] + clamp_bucket(fx, nbuckets[0]);
+	for (int k = first[b]; k < first[b + 1]; k++) {
+		int i = items[k];
+		const double* box = &boxes[4 * (size_t)i];
+		if (x < box[0] || x > box[2] || y < box[1] || y > box[3])
+			continue;
+		if (inside(i, x, y, s, t)) {
+			*quad = i;
+			return true;
+		}
+	}
+	return false;
+}
@@ -0,0 +1,63 @@
+/*
+
+Point location for field queries
+
+Finds the quad containing a point without scanning qlist. Structured grids
+answer by index arithmetic; any other mesh gets a uniform bucket grid over
+the bounding boxes of its quads.
+
+*/
+
+#ifndef __POINT_LOCATOR_H__
+#define __POINT_LOCATOR_H__
+
+#include <vector>
+
+class Polyhedron;
+
+/// <summary>
+/// Index over the quads of a Polyhedron, in the xy plane. Built once per mesh; the mesh must not change afterwards.
+/// </summary>
+class PointLocator {
+public:
+	PointLocator(Polyhedron* poly);
+
+	/// <summary>
+	/// Finds the quad containing (x, y) and the bilinear coordinates of the point inside it:
+	/// s from verts[0] towards verts[1] and t from verts[0] towards verts[3], both in [0, 1].
+	/// </summary>
+	/// <returns>False if no quad contains the point.</returns>
+	bool locate(double x, double y, int* quad, double* s, double* t) const;
+
+	/// <summary>
+	/// Same as locate() for just the one quad, e.g. to check whether a point is still in the quad it was last found in.
+	/// </summary>
+	bool inside(int quad, double x, double y, double* s, double* t) const;
+
+	/// <summary>
+	/// Same as locate(), but starts from the quad in *quad and walks across edges to its neighbors.
+	/// Cheap when the point has only moved a little since *quad was found; *quad may be -1 if there's no such quad.
+	/// </summary>
+	bool walk(double x, double y, int* quad, double* s, double* t) const;
+
+	/// <summary>
+	/// The quad across side j of a quad, i.e. across Quad::edges[j], or -1 on the boundary.
+	/// </summary>
+	int neighbor(int quad, int side) const;
+
+private:
+	Polyhedron* poly;
+
+	/* bilinear coordinates of a point in a quad, not clamped to it */
+	bool coordinates(int quad, double x, double y, double* s, double* t) const;
+
+	/* bucket grid, unused for structured grids */
+	double origin[2];
+	double bucket_size[2];
+	int nbuckets[2];
+	std::vector<int> first;		/* quads of bucket b are items[first[b] .. first[b + 1]) */
+	std::vector<int> items;
+	std::vector<double> boxes;	/* minx, miny, maxx, maxy of every quad */
+};
+
+#endif /* __POINT_LOCATOR_H__ */
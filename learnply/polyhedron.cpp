@@ -8,6 +8,9 @@ The polygon data structure
 */
 
 #include <math.h>
+#include <string.h>
+#include <charconv>
+#include <vector>
 #include <fstream>
 #include <iostream>
 #include "ply.h"
@@ -15,8 +18,207 @@ The polygon data structure
 #include "icMatrix.H"
 #include "polyhedron.h"
 #include "ply_io.h"
+#include "structured_grid.h"
+#include "point_locator.h"
 
-static PlyFile* in_ply;
+
+/******************************************************************************
+Check whether a PLY header declares exactly the layout of Vertex_io and
+Face_io (x,y,z,vx,vy,vz,s and a uint8/int32 vertex_indices list).
+******************************************************************************/
+static bool has_io_layout(PlyFile *ply)
+{
+	if (ply->num_elem_types != 2)
+		return false;
+
+	PlyElement *vert = ply->elems[0];
+	if (!equal_strings("vertex", vert->name) || vert->nprops != 7)
+		return false;
+	for (int i = 0; i < 7; i++) {
+		PlyProperty *prop = vert->props[i];
+		if (!equal_strings(vert_props[i].name, prop->name) || prop->is_list != PLY_SCALAR ||
+			prop->external_type != Float64)
+			return false;
+	}
+
+	PlyElement *face = ply->elems[1];
+	if (!equal_strings("face", face->name) || face->nprops != 1)
+		return false;
+	PlyProperty *prop = face->props[0];
+	return equal_strings("vertex_indices", prop->name) && prop->is_list == PLY_LIST &&
+		prop->count_external == Uint8 && prop->external_type == Int32;
+}
+
+/* skip blanks; with the end of line only if newline is set */
+static const char *skip_blanks(const char *p, const char *end, bool newline)
+{
+	while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || (newline && *p == '\n')))
+		p++;
+	return p;
+}
+
+template <class T>
+static const char *parse_ascii_item(const char *p, const char *end, T *value)
+{
+	p = skip_blanks(p, end, false);
+	if (p < end && *p == '+')
+		p++;
+	std::from_chars_result r = std::from_chars(p, end, *value);
+	return r.ec == std::errc() ? r.ptr : NULL;
+}
+
+/******************************************************************************
+Read the body of a file with the Vertex_io/Face_io layout straight into the
+vertex and quad lists, without going through get_words and store_item.
+
+Exit:
+  returns false if the body isn't one element per line as expected; the
+  caller then releases the arena and falls back to the generic reader
+******************************************************************************/
+static bool read_ascii_io_body(FILE *file, Polyhedron *poly)
+{
+	int vert_count = poly->nverts;
+	int quad_count = poly->nquads;
+	Vertex **verts = poly->vlist;
+	Quad **quads = poly->qlist;
+
+	long start = ftell(file);
+	fseek(file, 0, SEEK_END);
+	long stop = ftell(file);
+	fseek(file, start, SEEK_SET);
+
+	char *text = (char *)malloc(stop - start + 1);
+	size_t size = fread(text, 1, stop - start, file);
+	const char *p = text;
+	const char *end = text + size;
+	int nv = 0, nq = 0;
+	double val[7];
+
+	for (nv = 0; nv < vert_count && p != NULL; nv++) {
+		p = skip_blanks(p, end, true);
+		for (int j = 0; j < 7 && p != NULL; j++)
+			p = parse_ascii_item(p, end, &val[j]);
+		if (p == NULL)
+			break;
+		p = skip_blanks(p, end, false);
+		if (p < end && *p != '\n') {
+			p = NULL;
+			break;
+		}
+
+		verts[nv] = poly->new_vertex(val[0], val[1], val[2]);
+		verts[nv]->vx = val[3];
+		verts[nv]->vy = val[4];
+		verts[nv]->vz = val[5];
+		verts[nv]->scalar = val[6];
+	}
+
+	for (nq = 0; nq < quad_count && p != NULL; nq++) {
+		int n, index[4];
+		p = skip_blanks(p, end, true);
+		p = parse_ascii_item(p, end, &n);
+		if (p == NULL || n != 4) {
+			p = NULL;
+			break;
+		}
+		for (int j = 0; j < 4 && p != NULL; j++) {
+			p = parse_ascii_item(p, end, &index[j]);
+			if (p != NULL && (index[j] < 0 || index[j] >= vert_count))
+				p = NULL;
+		}
+		if (p == NULL)
+			break;
+		p = skip_blanks(p, end, false);
+		if (p < end && *p != '\n') {
+			p = NULL;
+			break;
+		}
+
+		quads[nq] = poly->new_quad();
+		for (int j = 0; j < 4; j++)
+			quads[nq]->verts[j] = verts[index[j]];
+		quads[nq]->other_props = NULL;
+	}
+
+	free(text);
+
+	if (p == NULL) {
+		fseek(file, start, SEEK_SET);
+		return false;
+	}
+	return true;
+}
+
+static bool host_is_little_endian()
+{
+	unsigned int one = 1;
+	return *(unsigned char *)&one == 1;
+}
+
+/******************************************************************************
+Read the body of a binary_little_endian file with the Vertex_io/Face_io
+layout as two blocks: 7 doubles per vertex, then a count byte and four
+int32 indices per face. Only valid on a little endian host.
+
+Exit:
+  returns false if the body is short or holds something other than quads;
+  the caller then releases the arena and falls back to the generic reader
+******************************************************************************/
+static bool read_binary_io_body(FILE *file, Polyhedron *poly)
+{
+	int vert_count = poly->nverts;
+	int quad_count = poly->nquads;
+	Vertex **verts = poly->vlist;
+	Quad **quads = poly->qlist;
+
+	const size_t vert_size = 7 * sizeof(double);
+	const size_t face_size = 1 + 4 * sizeof(int);
+	long start = ftell(file);
+	bool ok = true;
+	int nv = 0, nq = 0;
+
+	double *vert_block = (double *)malloc(vert_size * vert_count + 1);
+	unsigned char *face_block = (unsigned char *)malloc(face_size * quad_count + 1);
+	if (fread(vert_block, vert_size, vert_count, file) != (size_t)vert_count ||
+		fread(face_block, face_size, quad_count, file) != (size_t)quad_count)
+		ok = false;
+
+	for (nv = 0; ok && nv < vert_count; nv++) {
+		const double *val = vert_block + 7 * nv;
+		verts[nv] = poly->new_vertex(val[0], val[1], val[2]);
+		verts[nv]->vx = val[3];
+		verts[nv]->vy = val[4];
+		verts[nv]->vz = val[5];
+		verts[nv]->scalar = val[6];
+	}
+
+	for (nq = 0; ok && nq < quad_count; nq++) {
+		const unsigned char *face = face_block + face_size * nq;
+		int index[4];
+		memcpy(index, face + 1, sizeof(index));
+		if (face[0] != 4) {
+			ok = false;
+			break;
+		}
+		for (int j = 0; j < 4; j++)
+			if (index[j] < 0 || index[j] >= vert_count)
+				ok = false;
+		if (!ok)
+			break;
+
+		quads[nq] = poly->new_quad();
+		for (int j = 0; j < 4; j++)
+			quads[nq]->verts[j] = verts[index[j]];
+		quads[nq]->other_props = NULL;
+	}
+
+	free(vert_block);
+	free(face_block);
+
+	if (!ok)
+		fseek(file, start, SEEK_SET);
+	return ok;
+}
 
 
 /******************************************************************************
@@ -29,9 +231,48 @@ Polyhedron::Polyhedron(FILE *file)
 	char *elem_name;
 
 	/*** Read in the original PLY object ***/
-	in_ply = read_ply(file);
-
+	PlyFile* in_ply = read_ply(file);
+	for (i = 0; i < in_ply->num_comments; i++)
+		comments.push_back(in_ply->comments[i]);
+	for (i = 0; i < in_ply->num_obj_info; i++)
+		obj_info.push_back(in_ply->obj_info[i]);
+	vert_other = face_other = NULL;
+	elist = NULL;
+	nedges = max_edges = 0;
+	grid = NULL;
+	locator = NULL;
+
+	/* carve every vertex and quad out of one block */
+	size_t element_bytes = 0;
 	for (i = 0; i < in_ply->num_elem_types; i++) {
+		if (equal_strings("vertex", in_ply->elems[i]->name))
+			element_bytes += (size_t)in_ply->elems[i]->num * sizeof(Vertex);
+		else if (equal_strings("face", in_ply->elems[i]->name))
+			element_bytes += (size_t)in_ply->elems[i]->num * sizeof(Quad);
+	}
+	arena.reserve(element_bytes);
+
+	/* our own files all share one layout, so read those without the generic machinery */
+	bool fast = false;
+	bool binary = in_ply->file_type == PLY_BINARY_LE && host_is_little_endian();
+	if (has_io_layout(in_ply) && (in_ply->file_type == PLY_ASCII || binary)) {
+		nverts = max_verts = in_ply->elems[0]->num;
+		nquads = max_quads = in_ply->elems[1]->num;
+		vlist = new Vertex *[nverts];
+		qlist = new Quad *[nquads];
+		if (binary)
+			fast = read_binary_io_body(file, this);
+		else
+			fast = read_ascii_io_body(file, this);
+		if (!fast) {
+			delete[] vlist;
+			delete[] qlist;
+			arena.release();
+			arena.reserve(element_bytes);
+		}
+	}
+
+	for (i = 0; !fast && i < in_ply->num_elem_types; i++) {
 
 		/* prepare to read the i'th list of elements */
 		elem_name = setup_element_read_ply(in_ply, i, &elem_count);
@@ -61,7 +302,7 @@ Polyhedron::Polyhedron(FILE *file)
 				get_element_ply(in_ply, (void *)&vert);
 
 				/* copy info from the "vert" structure */
-				vlist[j] = new Vertex(vert.x, vert.y, vert.z);
+				vlist[j] = new_vertex(vert.x, vert.y, vert.z);
 				vlist[j]->vx = vert.vx;
 				vlist[j]->vy = vert.vy;
 				vlist[j]->vz = vert.vz;
@@ -93,7 +334,7 @@ Polyhedron::Polyhedron(FILE *file)
 				}
 
 				/* copy info from the "face" structure */
-				qlist[j] = new Quad;
+				qlist[j] = new_quad();
 				qlist[j]->verts[0] = (Vertex *)face.verts[0];
 				qlist[j]->verts[1] = (Vertex *)face.verts[1];
 				qlist[j]->verts[2] = (Vertex *)face.verts[2];
@@ -109,7 +350,7 @@ Polyhedron::Polyhedron(FILE *file)
 	close_ply(in_ply);
 
 	/* fix up vertex pointers in quads */
-	for (i = 0; i < nquads; i++) {
+	for (i = 0; !fast && i < nquads; i++) {
 		qlist[i]->verts[0] = vlist[(int)qlist[i]->verts[0]];
 		qlist[i]->verts[1] = vlist[(int)qlist[i]->verts[1]];
 		qlist[i]->verts[2] = vlist[(int)qlist[i]->verts[2]];
@@ -127,20 +368,48 @@ Polyhedron::Polyhedron(FILE *file)
 		Vertex *v3 = quad->verts[3];
 
 		if (v0 == v1 || v1 == v2 || v2 == v3 || v3 == v0) {
-			free(qlist[i]);
+			/* its memory stays in the arena until finalize() */
 			nquads--;
 			qlist[i] = qlist[nquads];
 		}
 	}
+
+	/* regular lattices get implicit topology in initialize() */
+	grid = StructuredGrid::detect(this);
 }
 
 Polyhedron::Polyhedron()
 {
 	nverts = nedges = nquads = 0;
 	max_verts = max_quads = 50;
+	max_edges = 0;
+	elist = NULL;
+	vert_other = face_other = NULL;
+
+	vlist = new Vertex * [max_verts];
+	qlist = new Quad * [max_quads];
+	grid = NULL;
+	locator = NULL;
+}
+
+/******************************************************************************
+Create an empty polyhedron with room for a known number of vertices and
+quads, for meshes that are built in memory instead of read from a file.
+******************************************************************************/
+Polyhedron::Polyhedron(int vert_count, int quad_count)
+{
+	nedges = max_edges = 0;
+	elist = NULL;
+	nverts = max_verts = vert_count;
+	nquads = max_quads = quad_count;
+	arena.reserve((size_t)vert_count * sizeof(Vertex) + (size_t)quad_count * sizeof(Quad));
 
 	vlist = new Vertex * [max_verts];
 	qlist = new Quad * [max_quads];
+
+	vert_other = face_other = NULL;
+	grid = NULL;
+	locator = NULL;
 }
 
 void Polyhedron::write_info()
@@ -160,25 +429,28 @@ void changeFile(FILE* file)
 
 /******************************************************************************
 Write out a polyhedron to a file.
+
+Entry:
+  file      - file to write to; must be opened "wb" for the binary formats
+  file_type - PLY_ASCII, PLY_BINARY_LE or PLY_BINARY_BE
+
+Exit:
+  file is closed; returns false if anything failed to write
 ******************************************************************************/
-void Polyhedron::write_file(FILE *file)
+bool Polyhedron::write_file(FILE *file, int file_type)
 {
 	int i;
 	PlyFile *ply;
-	char **elist;
-	int num_elem_types;
 
 	/*** Write out the transformed PLY object ***/
 
-	elist = get_element_list_ply(in_ply, &num_elem_types);
-	ply = write_ply(file, num_elem_types, elist, in_ply->file_type);
+	ply = write_ply(file, 2, elem_names, file_type);
 
 	/* describe what properties go into the vertex elements */
 
 	describe_element_ply(ply, "vertex", nverts);
-	describe_property_ply(ply, &vert_props[0]);
-	describe_property_ply(ply, &vert_props[1]);
-	describe_property_ply(ply, &vert_props[2]);
+	for (i = 0; i < 7; i++)
+		describe_property_ply(ply, &vert_props[i]);
 	//  describe_other_properties_ply (ply, vert_other, offsetof(Vertex_io,other_props));
 
 	describe_element_ply(ply, "face", nquads);
@@ -189,12 +461,15 @@ void Polyhedron::write_file(FILE *file)
 
 	//  describe_other_elements_ply (ply, in_ply->other_elems);
 
-	copy_comments_ply(ply, in_ply);
+	/* meshes built in memory (e.g. from a boids log) have no header to copy */
+	for (i = 0; i < (int)comments.size(); i++)
+		append_comment_ply(ply, (char*)comments[i].c_str());
 	char mm[1024];
 	sprintf(mm, "modified by learnply");
 	//  append_comment_ply (ply, "modified by simvizply %f");
 	append_comment_ply(ply, mm);
-	copy_obj_info_ply(ply, in_ply);
+	for (i = 0; i < (int)obj_info.size(); i++)
+		append_obj_info_ply(ply, (char*)obj_info[i].c_str());
 
 	header_complete_ply(ply);
 
@@ -207,6 +482,10 @@ void Polyhedron::write_file(FILE *file)
 		vert.x = vlist[i]->x;
 		vert.y = vlist[i]->y;
 		vert.z = vlist[i]->z;
+		vert.vx = vlist[i]->vx;
+		vert.vy = vlist[i]->vy;
+		vert.vz = vlist[i]->vz;
+		vert.s = vlist[i]->scalar;
 		vert.other_props = vlist[i]->other_props;
 
 		put_element_ply(ply, (void *)&vert);
@@ -234,10 +513,12 @@ void Polyhedron::write_file(FILE *file)
 
 		put_element_ply(ply, (void *)&face);
 	}
+	delete[] face.verts;
 	put_other_elements_ply(ply);
 
-	close_ply(ply);
+	bool written = close_ply(ply) == 0;
 	free_ply(ply);
+	return written;
 }
 
 void Polyhedron::initialize()
@@ -245,6 +526,17 @@ void Polyhedron::initialize()
 	selected_quad = -1;
 	selected_vertex = -1;
 
+	attributes.gather(vlist, nverts);
+	calc_scalar_stats();
+
+	if (grid) {
+		create_grid_pointers();
+		calc_bounding_sphere();
+		calc_face_normals_and_area();
+		average_normals();
+		return;
+	}
+
 	create_pointers();
 	calc_edge_length();
 	calc_bounding_sphere();
@@ -252,25 +544,27 @@ void Polyhedron::initialize()
 	average_normals();
 }
 
+/******************************************************************************
+Free the mesh. Every element and ring came out of the arena, so this is
+a handful of frees however large the mesh is.
+******************************************************************************/
 void Polyhedron::finalize() {
 
-	for (int i = 0; i < nquads; i++) {
-		//free(qlist[i]->other_props);
-		free(qlist[i]);
-	}
-	for (int i = 0; i < nedges; i++) {
-		free(elist[i]->quads);
-		free(elist[i]);
-	}
-	for (int i = 0; i < nverts; i++) {
-		free(vlist[i]->quads);
-		//free(vlist[i]->other_props);
-		free(vlist[i]);
-	}
-
-	free(qlist);
-	free(elist);
-	free(vlist);
+	arena.release();
+
+	delete[] qlist;
+	delete[] elist;
+	delete[] vlist;
+	qlist = NULL;
+	elist = NULL;
+	vlist = NULL;
+	nquads = nedges = nverts = 0;
+
+	delete grid;
+	grid = NULL;
+	delete locator;
+	locator = NULL;
+	attributes.clear();
 	if (!vert_other)
 		free(vert_other);
 	if (!face_other)
@@ -344,135 +638,72 @@ Quad *Polyhedron::find_common_edge(Quad *f1, Vertex *v1, Vertex *v2)
 
 
 /******************************************************************************
-Create an edge.
+Create edges.
 
-Entry:
-  v1,v2 - two vertices of f1 that define edge
+Each quad side is bucketed by its lower vertex index, and sides with the
+same upper index in a bucket are the same edge. That's linear in the mesh
+size for bounded valence, where the old find_common_edge/create_edge pair
+rescanned the vertex rings for every side. Edges are still created in the
+order quads and sides are visited, oriented like the side that creates them.
 ******************************************************************************/
 
-void Polyhedron::create_edge(Vertex *v1, Vertex *v2)
+void Polyhedron::create_edges()
 {
 	int i, j;
-	Quad *f;
-
-	/* make sure there is enough room for a new edge */
-
-	if (nedges >= max_edges) {
-
-		max_edges += 100;
-		Edge **list = new Edge *[max_edges];
-
-		/* copy the old list to the new one */
-		for (i = 0; i < nedges; i++)
-			list[i] = elist[i];
-
-		/* replace list */
-		free(elist);
-		elist = list;
-	}
+	int nsides = 4 * nquads;
 
-	/* create the edge */
-
-	elist[nedges] = new Edge;
-	Edge *e = elist[nedges];
-	e->index = nedges;
-	e->verts[0] = v1;
-	e->verts[1] = v2;
-	nedges++;
-
-	/* count all quads that will share the edge, and do this */
-	/* by looking through all faces of the first vertex */
-
-	e->nquads = 0;
-
-	for (i = 0; i < v1->nquads; i++) {
-		f = v1->quads[i];
-		/* examine the vertices of the face for a match with the second vertex */
+	/* side 4*i+j of quad i runs from verts[j] to verts[(j+1)%4] */
+	std::vector<int> low(nsides), high(nsides);
+	for (i = 0; i < nquads; i++)
 		for (j = 0; j < 4; j++) {
-			/* look for a match */
-			if (f->verts[j] == v2) {
-				e->nquads++;
-				break;
-			}
+			int a = qlist[i]->verts[j]->index;
+			int b = qlist[i]->verts[(j + 1) % 4]->index;
+			low[4 * i + j] = a < b ? a : b;
+			high[4 * i + j] = a < b ? b : a;
 		}
-	}
-
-	/* make room for the face pointers (at least two) */
-	if (e->nquads < 2)
-		e->quads = new Quad *[2];
-	else
-		e->quads = new Quad *[e->nquads];
-
-	/* create pointers from edges to faces and vice-versa */
 
-	e->nquads = 0; /* start this out at zero again for creating ptrs to quads */
-
-	for (i = 0; i < v1->nquads; i++) {
-
-		f = v1->quads[i];
-
-		/* examine the vertices of the face for a match with the second vertex */
-		for (j = 0; j < 4; j++)
-			if (f->verts[j] == v2) {
-
-				e->quads[e->nquads] = f;
-				e->nquads++;
-
-				if (f->verts[(j + 1) % 4] == v1)
-					f->edges[j] = e;
-				else if (f->verts[(j + 2) % 4] == v1)
-					f->edges[(j + 2) % 4] = e;
-				else if (f->verts[(j + 3) % 4] == v1)
-					f->edges[(j + 3) % 4] = e;
-				else {
-					fprintf(stderr, "Non-recoverable inconsistancy in create_edge()\n");
-					exit(-1);
+	/* bucket the sides by their lower vertex */
+	std::vector<int> start(nverts + 1, 0);
+	for (i = 0; i < nsides; i++)
+		start[low[i] + 1]++;
+	for (i = 0; i < nverts; i++)
+		start[i + 1] += start[i];
+	std::vector<int> bucket(nsides);
+	std::vector<int> fill(start.begin(), start.end() - 1);
+	for (i = 0; i < nsides; i++)
+		bucket[fill[low[i]]++] = i;
+
+	/* chain together the sides of each edge, first side (in quad order) first */
+	std::vector<int> first(nsides, -1), next(nsides, -1);
+	int count = 0;
+	for (int v = 0; v < nverts; v++) {
+		for (int m = start[v]; m < start[v + 1]; m++) {
+			int side = bucket[m];
+			for (int n = start[v]; n < m; n++) {
+				int other = bucket[n];
+				if (first[other] == other && high[other] == high[side]) {
+					int last = other;
+					while (next[last] >= 0)
+						last = next[last];
+					next[last] = side;
+					first[side] = other;
+					break;
 				}
-
-				break;  /* we'll only find one instance of v2 */
 			}
-
-	}
-}
-
-
-/******************************************************************************
-Create edges.
-******************************************************************************/
-
-void Polyhedron::create_edges()
-{
-	int i, j;
-	Quad *f;
-	Vertex *v1, *v2;
-	double count = 0;
-
-	/* count up how many edges we may require */
-
-	for (i = 0; i < nquads; i++) {
-		f = qlist[i];
-		for (j = 0; j < 4; j++) {
-			v1 = f->verts[j];
-			v2 = f->verts[(j + 1) % 4];
-			Quad *result = find_common_edge(f, v1, v2);
-			if (result)
-				count += 0.5;
-			else
-				count += 1;
+			if (first[side] < 0) {
+				first[side] = side;
+				count++;
+			}
 		}
 	}
 
-	/*
-	printf ("counted %f edges\n", count);
-	*/
+	/* create space for edge list, and room in the arena for the edges */
+	/* and their quad pointers (at least two each) */
 
-	/* create space for edge list */
-
-	max_edges = (int)(count + 10);  /* leave some room for expansion */
-	elist = new Edge *[max_edges];
+	max_edges = count;
+	elist = new Edge *[max_edges > 0 ? max_edges : 1];
 	nedges = 0;
-
-	/* zero out all the pointers from faces to edges */
+	arena.reserve((size_t)count * sizeof(Edge) + ((size_t)nsides + 2 * (size_t)count) * sizeof(Quad *));
 
 	for (i = 0; i < nquads; i++)
 		for (j = 0; j < 4; j++)
@@ -481,14 +712,30 @@ void Polyhedron::create_edges()
 	/* create all the edges by examining all the quads */
 
 	for (i = 0; i < nquads; i++) {
-		f = qlist[i];
 		for (j = 0; j < 4; j++) {
 			/* skip over edges that we've already created */
-			if (f->edges[j])
+			if (qlist[i]->edges[j])
 				continue;
-			v1 = f->verts[j];
-			v2 = f->verts[(j + 1) % 4];
-			create_edge(v1, v2);
+
+			Edge *e = new_edge();
+			e->index = nedges;
+			e->verts[0] = qlist[i]->verts[j];
+			e->verts[1] = qlist[i]->verts[(j + 1) % 4];
+			elist[nedges++] = e;
+
+			int side = first[4 * i + j];
+			int n = 0;
+			for (int k = side; k >= 0; k = next[k])
+				n++;
+
+			/* make room for the face pointers (at least two) */
+			e->quads = new_quad_ring(n < 2 ? 2 : n);
+			e->nquads = 0;
+			for (int k = side; k >= 0; k = next[k]) {
+				Quad *f = qlist[k / 4];
+				e->quads[e->nquads++] = f;
+				f->edges[k % 4] = e;
+			}
 		}
 	}
 }
@@ -519,9 +766,9 @@ void Polyhedron::vertex_to_quad_ptrs()
 
 	/* allocate memory for face pointers of vertices */
 
+	arena.reserve(4 * (size_t)nquads * sizeof(Quad *));
 	for (i = 0; i < nverts; i++) {
-		vlist[i]->quads = (Quad **)
-			malloc(sizeof(Quad *) * vlist[i]->max_quads);
+		vlist[i]->quads = new_quad_ring(vlist[i]->max_quads);
 		vlist[i]->nquads = 0;
 	}
 
@@ -561,9 +808,9 @@ void Polyhedron::vertex_to_edge_ptrs()
 
 	/* allocate memory for edge pointers of vertices */
 
+	arena.reserve(2 * (size_t)nedges * sizeof(Edge *));
 	for (int i = 0; i < nverts; i++) {
-		vlist[i]->edges = (Edge **)
-			malloc(sizeof(Edge *) * vlist[i]->max_edges);
+		vlist[i]->edges = new_edge_ring(vlist[i]->max_edges);
 		vlist[i]->nedges = 0;
 	}
 
@@ -596,6 +843,18 @@ Quad *Polyhedron::other_quad(Edge *edge, Quad *quad)
 	return (NULL);
 }
 
+/******************************************************************************
+Return the index used to find which quad a point is in, building it the
+first time it's asked for.
+******************************************************************************/
+
+PointLocator *Polyhedron::point_locator()
+{
+	if (!locator)
+		locator = new PointLocator(this);
+	return locator;
+}
+
 
 /******************************************************************************
 Order the pointers to faces that are around a given vertex.
@@ -615,6 +874,8 @@ void Polyhedron::order_vertex_to_quad_ptrs(Vertex *v)
 	int count;
 
 	nf = v->nquads;
+	if (nf == 0)
+		return;
 	f = v->quads[0];
 
 	/* go backwards (clockwise) around faces that surround a vertex */
@@ -660,10 +921,15 @@ void Polyhedron::order_vertex_to_quad_ptrs(Vertex *v)
 	}
 
 	/* now walk around the faces in the forward direction and place */
-	/* them in order */
+	/* them in order; on a manifold the walk meets every face once, so */
+	/* the ring is written out directly instead of swapped into place */
+
+	Quad *ring_buffer[16];
+	Quad **ring = nf <= 16 ? ring_buffer : new Quad *[nf];
 
 	f = v->quads[0];
-	count = 0;
+	ring[0] = f;
+	count = 1;
 
 	for (i = 1; i < nf; i++) {
 
@@ -685,21 +951,28 @@ void Polyhedron::order_vertex_to_quad_ptrs(Vertex *v)
 		fnext = other_quad(f->edges[vindex], f);
 
 		/* break out of loop if we've reached a boundary */
-		count = i;
-		if (fnext == NULL) {
+		if (fnext == NULL || fnext == ring[0])
 			break;
-		}
-
-		/* swap the next face into its proper place in the face list */
-		for (j = 0; j < v->nquads; j++)
-			if (v->quads[j] == fnext) {
-				v->quads[j] = v->quads[i];
-				v->quads[i] = fnext;
-				break;
-			}
 
+		ring[count++] = fnext;
 		f = fnext;
 	}
+
+	/* faces the walk didn't reach (non-manifold vertices) keep their old order */
+	if (count < nf) {
+		for (i = 0; i < nf && count < nf; i++) {
+			for (j = 0; j < count; j++)
+				if (ring[j] == v->quads[i])
+					break;
+			if (j == count)
+				ring[count++] = v->quads[i];
+		}
+	}
+
+	for (i = 0; i < nf; i++)
+		v->quads[i] = ring[i];
+	if (ring != ring_buffer)
+		delete[] ring;
 }
 
 
@@ -767,31 +1040,64 @@ void Polyhedron::create_pointers()
 
 }
 
-void Polyhedron::calc_bounding_sphere()
+/******************************************************************************
+Index a structured grid. Its neighbors are implicit in the indices, so no
+edges or vertex rings are built; Quad::edges and Vertex::quads stay empty.
+******************************************************************************/
+void Polyhedron::create_grid_pointers()
 {
-	unsigned int i;
-	icVector3 min, max;
+	int i;
 
 	for (i = 0; i < nverts; i++) {
-		if (i == 0) {
-			min.set(vlist[i]->x, vlist[i]->y, vlist[i]->z);
-			max.set(vlist[i]->x, vlist[i]->y, vlist[i]->z);
-		}
-		else {
-			if (vlist[i]->x < min.entry[0])
-				min.entry[0] = vlist[i]->x;
-			if (vlist[i]->x > max.entry[0])
-				max.entry[0] = vlist[i]->x;
-			if (vlist[i]->y < min.entry[1])
-				min.entry[1] = vlist[i]->y;
-			if (vlist[i]->y > max.entry[1])
-				max.entry[1] = vlist[i]->y;
-			if (vlist[i]->z < min.entry[2])
-				min.entry[2] = vlist[i]->z;
-			if (vlist[i]->z > max.entry[2])
-				max.entry[2] = vlist[i]->z;
-		}
+		Vertex *v = vlist[i];
+		v->index = i;
+		v->nquads = v->max_quads = 0;
+		v->quads = NULL;
+		v->nedges = v->max_edges = 0;
+		v->edges = NULL;
 	}
+
+	for (i = 0; i < nquads; i++) {
+		qlist[i]->index = i;
+		for (int j = 0; j < 4; j++)
+			qlist[i]->edges[j] = NULL;
+	}
+
+	elist = NULL;
+	nedges = max_edges = 0;
+}
+
+void Polyhedron::calc_bounding_box()
+{
+	int n = attributes.size();
+	attribute_bounds(attributes.x.data(), n, &minx, &maxx);
+	attribute_bounds(attributes.y.data(), n, &miny, &maxy);
+	attribute_bounds(attributes.z.data(), n, &minz, &maxz);
+}
+
+/******************************************************************************
+The scalar field doesn't change once loaded, so its range is found here once
+rather than by every frame that colors by it.
+******************************************************************************/
+void Polyhedron::calc_scalar_stats()
+{
+	int n = attributes.size();
+	min_scalar = max_scalar = mean_scalar = 0;
+	attribute_bounds(attributes.scalar.data(), n, &min_scalar, &max_scalar);
+
+	double sum = 0;
+	for (int i = 0; i < n; i++)
+		sum += attributes.scalar[i];
+	if (n > 0)
+		mean_scalar = sum / n;
+}
+
+void Polyhedron::calc_bounding_sphere()
+{
+	calc_bounding_box();
+
+	icVector3 min(minx, miny, minz);
+	icVector3 max(maxx, maxy, maxz);
 	center = (min + max) * 0.5;
 	radius = length(center - min);
 }
@@ -817,8 +1123,15 @@ void Polyhedron::calc_face_normals_and_area()
 
 	area = 0.0;
 	for (i = 0; i < nquads; i++) {
-		for (j = 0; j < 4; j++)
-			edge_length[j] = qlist[i]->edges[j]->length;
+		for (j = 0; j < 4; j++) {
+			if (grid) {
+				Vertex *a = qlist[i]->verts[j];
+				Vertex *b = qlist[i]->verts[(j + 1) % 4];
+				edge_length[j] = length(icVector3(a->x, a->y, a->z) - icVector3(b->x, b->y, b->z));
+			}
+			else
+				edge_length[j] = qlist[i]->edges[j]->length;
+		}
 
 		icVector3 d1, d2;
 		d1.set(qlist[i]->verts[0]->x, qlist[i]->verts[0]->y, qlist[i]->verts[0]->z);
@@ -859,6 +1172,21 @@ void Polyhedron::average_normals()
 {
 	int i, j;
 
+	if (grid) {
+		/* the quads around vertex (col, row) are the cells (col-1..col, row-1..row) */
+		int nx = grid->nx, ny = grid->ny;
+		for (i = 0; i < nverts; i++) {
+			int col = i % nx, row = i / nx;
+			vlist[i]->normal = icVector3(0.0);
+			for (int r = row - 1; r <= row; r++)
+				for (int c = col - 1; c <= col; c++)
+					if (r >= 0 && r < ny - 1 && c >= 0 && c < nx - 1)
+						vlist[i]->normal += qlist[grid->cell(c, r)]->normal;
+			normalize(vlist[i]->normal);
+		}
+		return;
+	}
+
 	for (i = 0; i < nverts; i++) {
 		vlist[i]->normal = icVector3(0.0);
 		for (j = 0; j < vlist[i]->nquads; j++)
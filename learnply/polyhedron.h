@@ -10,8 +10,13 @@ Eugene Zhang 2005
 #define __LEARNPLY_H__
 
 
+#include <new>
+#include <string>
+#include <vector>
 #include "ply.h"
 #include "icVector.H"
+#include "arena.h"
+#include "vertex_attributes.h"
 
 const double EPS = 1.0e-6;
 const double PI=3.1415926535898;
@@ -19,6 +24,8 @@ const double PI=3.1415926535898;
 /* forward declarations */
 class Quad;
 class Edge;
+class StructuredGrid;
+class PointLocator;
 
 class Vertex {
 public:
@@ -73,7 +80,8 @@ public:
 class Polyhedron {
 public:
 
-	int minx, maxx, miny, maxy;
+	double minx, maxx, miny, maxy, minz, maxz;	/* bounding box, set with the bounding sphere */
+	double min_scalar, max_scalar, mean_scalar;	/* of the scalar field, set by calc_scalar_stats() */
 
 	Quad **qlist;		/* list of quads */
 	int nquads;
@@ -98,19 +106,39 @@ public:
 
 	PlyOtherProp *vert_other,*face_other;
 
+	std::vector<std::string> comments, obj_info;	/* from the header of the PLY file, if the mesh was read from one */
+
+	StructuredGrid *grid;	/* implicit topology if the mesh is a regular lattice, else NULL */
+
+	Arena arena;		/* owns every Vertex, Quad, Edge and ring of the mesh */
+
+	PointLocator *locator;	/* built by point_locator() the first time a point has to be located */
+
+	VertexAttributes attributes;	/* contiguous copy of the vertex attributes, filled in by initialize() */
+
 	/*constructors*/
 	Polyhedron();
 	Polyhedron(FILE*);
+	Polyhedron(int, int);
+
+	/*element allocation, from the arena; released all at once by finalize()*/
+	Vertex *new_vertex(double x, double y, double z) { return new (arena.alloc(sizeof(Vertex), alignof(Vertex))) Vertex(x, y, z); }
+	Quad *new_quad() { return new (arena.alloc(sizeof(Quad), alignof(Quad))) Quad; }
+	Edge *new_edge() { return new (arena.alloc(sizeof(Edge), alignof(Edge))) Edge; }
+	Quad **new_quad_ring(int n) { return arena.alloc_array<Quad *>(n); }
+	Edge **new_edge_ring(int n) { return arena.alloc_array<Edge *>(n); }
 
 	/*initialization functions*/
 	void create_pointers();
+	void create_grid_pointers();
 	void average_normals();
-	void create_edge(Vertex *, Vertex *);
 	void create_edges();
 	int face_to_vertex_ref(Quad *, Vertex *);
 	void order_vertex_to_quad_ptrs(Vertex *);
 	void vertex_to_quad_ptrs();
 	void vertex_to_edge_ptrs();
+	void calc_bounding_box();
+	void calc_scalar_stats();
 	void calc_bounding_sphere();
 	void calc_face_normals_and_area();
 	void calc_edge_length();
@@ -118,11 +146,12 @@ public:
 	/*utilties*/
 	Quad* find_common_edge(Quad*, Vertex*, Vertex*);
 	Quad* other_quad(Edge*, Quad*);
+	PointLocator* point_locator();
 	void changeFile(FILE* file);
 
 	/*feel free to add more to help youself*/
 	void write_info();
-	void write_file(FILE *);
+	bool write_file(FILE *, int file_type = PLY_ASCII);
 
 
 	/*initialization and finalization*/
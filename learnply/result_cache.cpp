@@ -0,0 +1,263 @@
+/*
+
+Cache of generated lines
+
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include "mapped_file.h"
+#include "topo_cache.h"
+#include "result_cache.h"
+
+/*
+Layout of a .lines file. Sections follow the header in this order:
+
+  double  params [nparams]
+  double  points [npoints][3]
+  int32   counts [nlines]
+
+Line i takes counts[i] points from where line i - 1 left off, as a
+StreamlineStore keeps them: none, or two and more joined by segments.
+Vector glyphs are lines of two points each.
+*/
+struct LinesHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t kind;
+	uint64_t source_hash;
+	uint64_t source_size;
+	int32_t nparams;
+	int32_t nlines;
+	int32_t npoints;
+	int32_t unused;
+};
+
+static const char LINES_MAGIC[8] = { 'L', 'P', 'L', 'I', 'N', 'E', 'S', '\0' };
+
+bool ResultKey::operator==(const ResultKey& other) const
+{
+	return source_hash == other.source_hash && source_size == other.source_size &&
+		kind == other.kind && params == other.params;
+}
+
+static size_t store_bytes(const StreamlineStore& lines)
+{
+	return lines.points.size() * sizeof(icVector3) + lines.first.size() * sizeof(int);
+}
+
+/******************************************************************************
+Writes lines to path in the layout above.
+
+Exit:
+  returns false if the file couldn't be written; nothing is left behind
+******************************************************************************/
+static bool write_lines(const char* path, const ResultKey& key, const StreamlineStore& lines)
+{
+	std::vector<int32_t> counts(lines.size());
+	for (int i = 0; i < lines.size(); i++)
+		counts[i] = lines.point_count(i);
+	std::vector<double> points;
+	points.reserve(3 * lines.points.size());
+	for (size_t i = 0; i < lines.points.size(); i++)
+		points.insert(points.end(), { lines.points[i].x, lines.points[i].y, lines.points[i].z });
+
+	LinesHeader h;
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, LINES_MAGIC, sizeof(LINES_MAGIC));
+	h.version = RESULT_CACHE_VERSION;
+	h.kind = key.kind;
+	h.source_hash = key.source_hash;
+	h.source_size = key.source_size;
+	h.nparams = (int32_t)key.params.size();
+	h.nlines = (int32_t)counts.size();
+	h.npoints = (int32_t)(points.size() / 3);
+
+	FILE* file = fopen(path, "wb");
+	if (file == NULL)
+		return false;
+
+	bool ok = fwrite(&h, sizeof(h), 1, file) == 1 &&
+		fwrite(key.params.data(), sizeof(double), key.params.size(), file) == key.params.size() &&
+		fwrite(points.data(), sizeof(double), points.size(), file) == points.size() &&
+		fwrite(counts.data(), sizeof(int32_t), counts.size(), file) == counts.size();
+	ok = (fclose(file) == 0) && ok;
+
+	if (!ok)
+		remove(path);
+	return ok;
+}
+
+/******************************************************************************
+Reads the lines of key back from path.
+
+Exit:
+  returns false if there's no file, or it was written for another source,
+  generator or parameters, or it's damaged; lines is untouched then
+******************************************************************************/
+static bool read_lines(const char* path, const ResultKey& key, StreamlineStore& lines)
+{
+	MappedFile file;
+	if (!file.open(path) || file.size() < sizeof(LinesHeader))
+		return false;
+
+	const LinesHeader* h = (const LinesHeader*)file.data();
+	if (memcmp(h->magic, LINES_MAGIC, sizeof(LINES_MAGIC)) != 0 || h->version != RESULT_CACHE_VERSION ||
+		h->kind != (uint32_t)key.kind || h->source_hash != key.source_hash || h->source_size != key.source_size ||
+		h->nparams != (int32_t)key.params.size() || h->nlines < 0 || h->npoints < 0)
+		return false;
+	size_t expected = sizeof(LinesHeader) + sizeof(double) * (key.params.size() + 3 * (size_t)h->npoints)
+		+ sizeof(int32_t) * (size_t)h->nlines;
+	if (file.size() != expected)
+		return false;
+
+	const double* params = (const double*)(h + 1);
+	const double* points = params + h->nparams;
+	const int32_t* counts = (const int32_t*)(points + 3 * (size_t)h->npoints);
+	if (memcmp(params, key.params.data(), sizeof(double) * key.params.size()) != 0)
+		return false;
+
+	/* the counts have to account for exactly the points there are */
+	size_t total = 0;
+	for (int i = 0; i < h->nlines; i++) {
+		if (counts[i] < 0 || counts[i] == 1)
+			return false;
+		total += (size_t)counts[i];
+	}
+	if (total != (size_t)h->npoints)
+		return false;
+
+	StreamlineStore read;
+	read.first.reserve((size_t)h->nlines + 1);
+	read.points.resize(h->npoints);
+	for (int i = 0; i < h->npoints; i++)
+		read.points[i].set(points[3 * i], points[3 * i + 1], points[3 * i + 2]);
+	for (int i = 0; i < h->nlines; i++)
+		read.first.push_back(read.first.back() + counts[i]);
+
+	lines.points.swap(read.points);
+	lines.first.swap(read.first);
+	return true;
+}
+
+ResultCache::ResultCache(size_t budget)
+	: persist(false), budget(budget), used(0), source_ok(false), source_hash(0), source_size(0)
+{
+}
+
+bool ResultCache::set_source(const char* path)
+{
+	source_path = path;
+	source_ok = hash_source(path, &source_hash, &source_size);
+	return source_ok;
+}
+
+ResultKey ResultCache::make_key(ResultKind kind, const std::vector<double>& params) const
+{
+	ResultKey key;
+	key.source_hash = source_hash;
+	key.source_size = source_size;
+	key.kind = kind;
+	key.params = params;
+	return key;
+}
+
+/* <source>.<FNV-1a of the generator and parameters>.lines; the header checks the rest */
+std::string ResultCache::file_path(const ResultKey& key) const
+{
+	uint64_t h = 14695981039346656037ULL;
+	const uint64_t prime = 1099511628211ULL;
+	h = (h ^ (uint64_t)key.kind) * prime;
+	for (size_t i = 0; i < key.params.size(); i++) {
+		uint64_t word;
+		memcpy(&word, &key.params[i], 8);
+		h = (h ^ word) * prime;
+	}
+
+	char name[24];
+	snprintf(name, sizeof(name), ".%016llx", (unsigned long long)h);
+	return source_path + name + ".lines";
+}
+
+/******************************************************************************
+Puts a copy of lines at the front of the memory cache and drops the least
+recently used results until it's back under budget.
+******************************************************************************/
+void ResultCache::keep(const ResultKey& key, const StreamlineStore& lines)
+{
+	size_t bytes = store_bytes(lines);
+	if (bytes > budget)
+		return;
+
+	for (std::list<Entry>::iterator it = entries.begin(); it != entries.end(); ++it)
+		if (it->key == key) {
+			used -= it->bytes;
+			entries.erase(it);
+			break;
+		}
+
+	entries.push_front(Entry());
+	entries.front().key = key;
+	entries.front().lines = lines;
+	entries.front().bytes = bytes;
+	used += bytes;
+
+	while (used > budget) {
+		used -= entries.back().bytes;
+		entries.pop_back();
+	}
+}
+
+bool ResultCache::find(ResultKind kind, const std::vector<double>& params, StreamlineStore& lines)
+{
+	if (!source_ok)
+		return false;
+
+	ResultKey key = make_key(kind, params);
+	for (std::list<Entry>::iterator it = entries.begin(); it != entries.end(); ++it)
+		if (it->key == key) {
+			entries.splice(entries.begin(), entries, it);
+			lines = it->lines;
+			return true;
+		}
+
+	if (!persist || !read_lines(file_path(key).c_str(), key, lines))
+		return false;
+	keep(key, lines);
+	return true;
+}
+
+bool ResultCache::find(ResultKind kind, const std::vector<double>& params, PolyLine& segments)
+{
+	StreamlineStore lines;
+	if (!find(kind, params, lines))
+		return false;
+	segments.clear();
+	lines.segments(segments);
+	return true;
+}
+
+void ResultCache::store(ResultKind kind, const std::vector<double>& params, const StreamlineStore& lines)
+{
+	if (!source_ok)
+		return;
+
+	ResultKey key = make_key(kind, params);
+	keep(key, lines);
+	if (persist)
+		write_lines(file_path(key).c_str(), key, lines); // a read-only dataset directory just isn't persisted
+}
+
+void ResultCache::store(ResultKind kind, const std::vector<double>& params, const PolyLine& segments)
+{
+	StreamlineStore lines;
+	lines.append(segments);
+	store(kind, params, lines);
+}
+
+void ResultCache::clear()
+{
+	entries.clear();
+	used = 0;
+}
@@ -0,0 +1,103 @@
+/*
+
+Cache of generated lines: the vector glyphs and streamlines of a dataset
+
+Results are keyed by the source file (its size and content hash, as for the
+.topo cache) and every parameter they were generated with, so going back to
+a dataset, integrator or placement already seen copies the lines instead of
+tracing them again. The most recently used results are kept in memory up to
+a byte budget, and with persist set every result is also written next to
+its source as <source>.<key hash>.lines, so they outlive the viewer.
+
+*/
+
+#ifndef __RESULT_CACHE_H__
+#define __RESULT_CACHE_H__
+
+#include <stdint.h>
+#include <list>
+#include <string>
+#include <vector>
+#include "streamline.h"
+
+/// <summary>
+/// Bumped whenever the layout of a .lines file changes.
+/// </summary>
+const unsigned int RESULT_CACHE_VERSION = 2;
+
+/// <summary>
+/// What generated a result. Part of the key, so equal parameters of different generators never collide.
+/// </summary>
+enum ResultKind {
+	RESULT_VECTORS,
+	RESULT_STREAMLINES,
+	RESULT_PLACED_STREAMLINES,
+};
+
+/// <summary>
+/// A result's identity. Parameters are compared exactly, so they must be generated the same way every time.
+/// </summary>
+struct ResultKey {
+	uint64_t source_hash;
+	uint64_t source_size;
+	ResultKind kind;
+	std::vector<double> params;
+
+	bool operator==(const ResultKey& other) const;
+};
+
+class ResultCache {
+public:
+	/// <summary>
+	/// Keeps up to budget bytes of lines in memory. A result bigger than the whole budget is only persisted.
+	/// </summary>
+	ResultCache(size_t budget = 64 << 20);
+
+	bool persist;	/* also read and write .lines files next to the source */
+
+	/// <summary>
+	/// Makes path the source of every result found or stored from now on. Results of earlier sources stay cached.
+	/// </summary>
+	/// <returns>False if path can't be read, in which case nothing is cached until the next source.</returns>
+	bool set_source(const char* path);
+
+	/// <summary>
+	/// Copies the result of kind and params for the current source into lines, from memory or disk.
+	/// </summary>
+	/// <returns>False on a miss; lines is untouched.</returns>
+	bool find(ResultKind kind, const std::vector<double>& params, StreamlineStore& lines);
+	bool find(ResultKind kind, const std::vector<double>& params, PolyLine& segments);
+
+	/// <summary>
+	/// Caches a copy of lines as the result of kind and params for the current source.
+	/// </summary>
+	void store(ResultKind kind, const std::vector<double>& params, const StreamlineStore& lines);
+	void store(ResultKind kind, const std::vector<double>& params, const PolyLine& segments);
+
+	/// <summary>
+	/// Forgets everything held in memory. Files on disk are kept.
+	/// </summary>
+	void clear();
+
+private:
+	struct Entry {
+		ResultKey key;
+		StreamlineStore lines;
+		size_t bytes;
+	};
+
+	ResultKey make_key(ResultKind kind, const std::vector<double>& params) const;
+	std::string file_path(const ResultKey& key) const;
+	void keep(const ResultKey& key, const StreamlineStore& lines);
+
+	std::list<Entry> entries;	/* most recently used first */
+	size_t budget;
+	size_t used;
+
+	std::string source_path;
+	bool source_ok;
+	uint64_t source_hash;
+	uint64_t source_size;
+};
+
+#endif /* __RESULT_CACHE_H__ */
@@ -0,0 +1,388 @@
+/*
+
+Streamline tracing
+
+*/
+
+#include <math.h>
+#include <mutex>
+#include <thread>
+#include "polyhedron.h"
+#include "point_locator.h"
+#include "vertex_attributes.h"
+#include "streamline.h"
+
+/* Dormand-Prince tableau. B is the fifth order solution, E the difference to the embedded fourth order one */
+static const double DP_A[6][5] = {
+	{ 1.0 / 5 },
+	{ 3.0 / 40, 9.0 / 40 },
+	{ 44.0 / 45, -56.0 / 15, 32.0 / 9 },
+	{ 19372.0 / 6561, -25360.0 / 2187, 64448.0 / 6561, -212.0 / 729 },
+	{ 9017.0 / 3168, -355.0 / 33, 46732.0 / 5247, 49.0 / 176, -5103.0 / 18656 },
+	{ 35.0 / 384, 0, 500.0 / 1113, 125.0 / 192, -2187.0 / 6784 }
+};
+static const double DP_B[6] = { 35.0 / 384, 0, 500.0 / 1113, 125.0 / 192, -2187.0 / 6784, 11.0 / 84 };
+static const double DP_E[7] = { 71.0 / 57600, 0, -71.0 / 16695, 71.0 / 1920, -17253.0 / 339200, 22.0 / 525, -1.0 / 40 };
+
+const char* integrator_name(Integrator integrator)
+{
+	switch (integrator) {
+	case INTEGRATE_EULER: return "Euler";
+	case INTEGRATE_RK2: return "RK2";
+	case INTEGRATE_RK4: return "RK4";
+	case INTEGRATE_RK45: return "RK45";
+	default: return "?";
+	}
+}
+
+StreamlineTracer::StreamlineTracer(Polyhedron* poly, const TraceOptions& options)
+	: cursor(poly)
+{
+	this->options = options;
+	evaluations = 0;
+	guard = NULL;
+
+	VertexAttributes& attr = poly->attributes;
+	slowest = options.min_speed * max_magnitude(attr.vx.data(), attr.vy.data(), attr.vz.data(), attr.size());
+	direction = 1;
+}
+
+bool StreamlineTracer::direction_at(double x, double y, double d[2], TraceEnd* why)
+{
+	icVector3 v;
+	evaluations++;
+	if (!cursor.sample(x, y, &v)) {
+		*why = TRACE_LEFT_DOMAIN;
+		return false;
+	}
+
+	double speed = sqrt(v.x * v.x + v.y * v.y);
+	if (!(speed > slowest) || speed == 0) {
+		*why = TRACE_STALLED;
+		return false;
+	}
+	d[0] = direction * v.x / speed;
+	d[1] = direction * v.y / speed;
+	return true;
+}
+
+bool StreamlineTracer::fixed_step(const double p[2], const double k1[2], double h, double next[2], TraceEnd* why)
+{
+	double k2[2], k3[2], k4[2];
+
+	switch (options.integrator) {
+	case INTEGRATE_RK2:
+		if (!direction_at(p[0] + 0.5 * h * k1[0], p[1] + 0.5 * h * k1[1], k2, why))
+			return false;
+		next[0] = p[0] + h * k2[0];
+		next[1] = p[1] + h * k2[1];
+		return true;
+
+	case INTEGRATE_RK4:
+		if (!direction_at(p[0] + 0.5 * h * k1[0], p[1] + 0.5 * h * k1[1], k2, why) ||
+			!direction_at(p[0] + 0.5 * h * k2[0], p[1] + 0.5 * h * k2[1], k3, why) ||
+			!direction_at(p[0] + h * k3[0], p[1] + h * k3[1], k4, why))
+			return false;
+		next[0] = p[0] + h * (k1[0] + 2 * k2[0] + 2 * k3[0] + k4[0]) / 6;
+		next[1] = p[1] + h * (k1[1] + 2 * k2[1] + 2 * k3[1] + k4[1]) / 6;
+		return true;
+
+	default:
+		next[0] = p[0] + h * k1[0];
+		next[1] = p[1] + h * k1[1];
+		return true;
+	}
+}
+
+/******************************************************************************
+Take one Dormand-Prince step. The last stage is the direction at the new
+point, which is also the first stage of the following step, so an accepted
+step costs six samples. A rejected step is retried shorter, and so is one whose
+stages leave the mesh or stall, down to the fixed step; only then does the
+trace stop there. A step that still misses the tolerance at min_step is circling
+a critical point and stalls the trace.
+******************************************************************************/
+
+bool StreamlineTracer::adaptive_step(const double p[2], const double k1[2], double* h, double max_h,
+	double next[2], double knext[2], TraceEnd* why)
+{
+	double k[7][2];
+	k[0][0] = k1[0];
+	k[0][1] = k1[1];
+
+	for (;;) {
+		double hh = fmin(*h, max_h);
+		bool sampled = true;
+
+		for (int i = 1; i < 6 && sampled; i++) {
+			double x = p[0], y = p[1];
+			for (int j = 0; j < i; j++) {
+				x += hh * DP_A[i - 1][j] * k[j][0];
+				y += hh * DP_A[i - 1][j] * k[j][1];
+			}
+			sampled = direction_at(x, y, k[i], why);
+		}
+
+		if (sampled) {
+			next[0] = p[0];
+			next[1] = p[1];
+			for (int j = 0; j < 6; j++) {
+				next[0] += hh * DP_B[j] * k[j][0];
+				next[1] += hh * DP_B[j] * k[j][1];
+			}
+			sampled = direction_at(next[0], next[1], k[6], why);
+		}
+
+		if (sampled) {
+			double ex = 0, ey = 0;
+			for (int j = 0; j < 7; j++) {
+				ex += DP_E[j] * k[j][0];
+				ey += DP_E[j] * k[j][1];
+			}
+			double err = hh * fmax(fabs(ex), fabs(ey));
+
+			/* the usual controller: aim for 0.9 of the tolerance, change by at most 5x */
+			double factor = err > 0 ? 0.9 * pow(options.tolerance / err, 0.2) : 5.0;
+			factor = fmin(fmax(factor, 0.2), 5.0);
+
+			if (err <= options.tolerance) {
+				knext[0] = k[6][0];
+				knext[1] = k[6][1];
+				*h = fmin(fmax(hh * factor, options.min_step), options.max_step);
+				return true;
+			}
+			/* the direction only turns this fast right next to a critical point */
+			if (hh <= options.min_step) {
+				*why = TRACE_STALLED;
+				return false;
+			}
+			*h = fmax(hh * factor, options.min_step);
+		}
+		else {
+			/* end within a fixed step of the boundary, like the other integrators do */
+			if (hh <= options.step)
+				return false;
+			*h = fmax(hh * 0.25, options.step);
+		}
+	}
+}
+
+TraceEnd StreamlineTracer::trace(double x, double y, double z, double direction, PolyLine& contour)
+{
+	this->direction = direction < 0 ? -1 : 1;
+	cursor.reset();
+
+	TraceEnd why;
+	double p[2] = { x, y };
+	double k1[2];
+	if (!direction_at(x, y, k1, &why))
+		return why;
+
+	double h = options.integrator == INTEGRATE_RK45 ? fmin(options.step, options.max_step) : options.step;
+	double length = 0;
+
+	for (int i = 0; i < options.max_steps; i++) {
+		double remaining = options.max_length - length;
+		double next[2], knext[2];
+
+		if (options.integrator == INTEGRATE_RK45) {
+			if (!adaptive_step(p, k1, &h, remaining, next, knext, &why))
+				return why;
+		}
+		else {
+			if (!fixed_step(p, k1, fmin(h, remaining), next, &why) || !direction_at(next[0], next[1], knext, &why))
+				return why;
+		}
+
+		if (guard && !guard->accept(p, next))
+			return TRACE_BLOCKED;
+
+		LineSegment line(p[0], p[1], z, next[0], next[1], z);
+		contour.push_back(line);
+		length += line.len;
+
+		p[0] = next[0];
+		p[1] = next[1];
+		k1[0] = knext[0];
+		k1[1] = knext[1];
+
+		/* chords are a little shorter than the steps along a curve; don't chase the last sliver */
+		if (length >= options.max_length * (1 - 1.0e-9))
+			return TRACE_MAX_LENGTH;
+	}
+	return TRACE_MAX_STEPS;
+}
+
+void StreamlineTracer::trace_both(double x, double y, double z, PolyLine& contour)
+{
+	size_t begin = contour.size();
+	trace(x, y, z, 1, contour);
+	size_t split = contour.size();
+	trace(x, y, z, -1, contour);
+	join_at_seed(contour, begin, split);
+}
+
+void join_at_seed(PolyLine& contour, size_t begin, size_t split)
+{
+	PolyLine joined;
+	joined.reserve(contour.size() - begin);
+	for (size_t i = contour.size(); i > split; i--)
+		joined.push_back(LineSegment(contour[i - 1].end, contour[i - 1].start));
+	joined.insert(joined.end(), contour.begin() + begin, contour.begin() + split);
+	contour.erase(contour.begin() + begin, contour.end());
+	contour.insert(contour.end(), joined.begin(), joined.end());
+}
+
+static bool same_point(const icVector3& a, const icVector3& b)
+{
+	return a.x == b.x && a.y == b.y && a.z == b.z;
+}
+
+void StreamlineStore::append(const PolyLine& line)
+{
+	for (size_t i = 0; i < line.size(); i++) {
+		if (i == 0 || !same_point(line[i - 1].end, line[i].start)) {
+			if (i > 0)
+				first.push_back((int)points.size());
+			points.push_back(line[i].start);
+		}
+		points.push_back(line[i].end);
+	}
+	first.push_back((int)points.size());
+}
+
+void StreamlineStore::segments(PolyLine& out) const
+{
+	for (int i = 0; i < size(); i++)
+		for (int j = first[i] + 1; j < first[i + 1]; j++)
+			out.push_back(LineSegment(points[j - 1], points[j]));
+}
+
+/******************************************************************************
+Parallel tracing. Seeds are dealt out in chunks, a contiguous run of chunks
+per thread. A thread works from the front of its own run and, once that's
+empty, steals from the back of someone else's, so a thread that drew short
+lines helps with the long ones. Lines go to the thread's own buffer and are
+copied out in seed order at the end, which is what keeps the result the
+same for any number of threads.
+******************************************************************************/
+
+/* the chunks [next, end) still waiting for a thread */
+struct TraceQueue {
+	std::mutex lock;
+	int next, end;
+};
+
+/* where a seed's line ended up: points [begin, end) of a thread's buffer */
+struct TracedLine {
+	int thread;
+	int begin, end;
+};
+
+struct TraceWork {
+	Polyhedron* poly;
+	const TraceOptions* options;
+	const std::vector<icVector3>* seeds;
+	int chunk_size;
+	std::vector<TraceQueue> queues;
+	std::vector<std::vector<icVector3> > buffers;
+	std::vector<TracedLine> lines;
+};
+
+static bool take_chunk(TraceQueue& queue, bool back, int* chunk)
+{
+	std::lock_guard<std::mutex> guard(queue.lock);
+	if (queue.next >= queue.end)
+		return false;
+	*chunk = back ? --queue.end : queue.next++;
+	return true;
+}
+
+static void trace_worker(TraceWork* work, int thread)
+{
+	StreamlineTracer tracer(work->poly, *work->options);
+	std::vector<icVector3>& buffer = work->buffers[thread];
+	const std::vector<icVector3>& seeds = *work->seeds;
+	int nthreads = (int)work->queues.size();
+	PolyLine line;
+
+	for (;;) {
+		int chunk;
+		bool found = take_chunk(work->queues[thread], false, &chunk);
+		for (int k = 1; !found && k < nthreads; k++)
+			found = take_chunk(work->queues[(thread + k) % nthreads], true, &chunk);
+		if (!found)
+			return;	/* nothing is ever added, so once every queue is empty we're done */
+
+		int begin = chunk * work->chunk_size;
+		int end = begin + work->chunk_size < (int)seeds.size() ? begin + work->chunk_size : (int)seeds.size();
+		for (int i = begin; i < end; i++) {
+			line.clear();
+			tracer.trace_both(seeds[i].x, seeds[i].y, seeds[i].z, line);
+
+			TracedLine& where = work->lines[i];
+			where.thread = thread;
+			where.begin = (int)buffer.size();
+			if (!line.empty())
+				buffer.push_back(line[0].start);
+			for (size_t j = 0; j < line.size(); j++)
+				buffer.push_back(line[j].end);
+			where.end = (int)buffer.size();
+		}
+	}
+}
+
+void trace_streamlines(Polyhedron* poly, const TraceOptions& options, const std::vector<icVector3>& seeds,
+	StreamlineStore& store, int nthreads)
+{
+	store.clear();
+	int nseeds = (int)seeds.size();
+	if (nseeds == 0)
+		return;
+
+	/* build the locator before anyone needs it, it's made on first use */
+	poly->point_locator();
+
+	if (nthreads <= 0)
+		nthreads = (int)std::thread::hardware_concurrency();
+	if (nthreads <= 0)
+		nthreads = 1;
+	if (nthreads > nseeds)
+		nthreads = nseeds;
+
+	/* enough chunks per thread for stealing to even things out */
+	TraceWork work;
+	work.poly = poly;
+	work.options = &options;
+	work.seeds = &seeds;
+	work.chunk_size = nseeds / (nthreads * 16) > 0 ? nseeds / (nthreads * 16) : 1;
+	int nchunks = (nseeds + work.chunk_size - 1) / work.chunk_size;
+
+	work.queues = std::vector<TraceQueue>(nthreads);
+	for (int t = 0; t < nthreads; t++) {
+		work.queues[t].next = (int)((long long)nchunks * t / nthreads);
+		work.queues[t].end = (int)((long long)nchunks * (t + 1) / nthreads);
+	}
+	work.buffers.resize(nthreads);
+	work.lines.resize(nseeds);
+
+	std::vector<std::thread> workers;
+	for (int t = 1; t < nthreads; t++)
+		workers.push_back(std::thread(trace_worker, &work, t));
+	trace_worker(&work, 0);
+	for (size_t i = 0; i < workers.size(); i++)
+		workers[i].join();
+
+	/* copy out in seed order */
+	size_t total = 0;
+	for (int t = 0; t < nthreads; t++)
+		total += work.buffers[t].size();
+	store.points.reserve(total);
+	store.first.reserve(nseeds + 1);
+	for (int i = 0; i < nseeds; i++) {
+		const TracedLine& where = work.lines[i];
+		const std::vector<icVector3>& buffer = work.buffers[where.thread];
+		store.points.insert(store.points.end(), buffer.begin() + where.begin, buffer.begin() + where.end);
+		store.first.push_back((int)store.points.size());
+	}
+}
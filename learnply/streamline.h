@@ -0,0 +1,152 @@
+/*
+
+Streamline tracing
+
+Streamlines follow the direction of the field at unit speed, so the
+parameter is arc length and a step of h adds h to the line. The step is
+taken with a selectable integrator; Dormand-Prince RK45 also picks its own
+step size from an error estimate, so straight flow is crossed in a few
+long steps and curved flow near critical points in many short ones.
+
+*/
+
+#ifndef __STREAMLINE_H__
+#define __STREAMLINE_H__
+
+#include <vector>
+#include "polyline.h"
+#include "field_cursor.h"
+
+class Polyhedron;
+
+enum Integrator {
+	INTEGRATE_EULER,
+	INTEGRATE_RK2,		/* midpoint */
+	INTEGRATE_RK4,
+	INTEGRATE_RK45,		/* Dormand-Prince, adaptive step */
+	INTEGRATOR_COUNT
+};
+
+/// <summary>
+/// Name of an integrator for messages, e.g. "RK45".
+/// </summary>
+const char* integrator_name(Integrator integrator);
+
+/// <summary>
+/// Why a trace stopped.
+/// </summary>
+enum TraceEnd {
+	TRACE_MAX_LENGTH,	/* reached max_length */
+	TRACE_MAX_STEPS,	/* took max_steps steps */
+	TRACE_LEFT_DOMAIN,	/* the next point would be outside the mesh */
+	TRACE_STALLED,		/* the field is slower than min_speed, e.g. at a critical point */
+	TRACE_BLOCKED		/* the tracer's guard turned the next step down */
+};
+
+/// <summary>
+/// Lets whoever is tracing end a line early, e.g. when it runs into lines that are already there.
+/// </summary>
+class TraceGuard {
+public:
+	virtual ~TraceGuard() {}
+
+	/// <summary>
+	/// Called before each step is added to the line, with the step's ends.
+	/// </summary>
+	/// <returns>False to end the line before this step.</returns>
+	virtual bool accept(const double from[2], const double to[2]) = 0;
+};
+
+/// <summary>
+/// How to trace. The defaults give the old fixed .25 Euler step a 375 unit budget, the length of 1500 such steps.
+/// </summary>
+struct TraceOptions {
+	Integrator integrator = INTEGRATE_RK45;
+	double step = 0.25;			/* step for the fixed-step integrators, first step for RK45 */
+	double min_step = 1.0e-3;	/* RK45 never steps shorter than this */
+	double max_step = 2.0;		/* or longer than this */
+	double tolerance = 1.0e-3;	/* RK45 position error allowed per step */
+	double max_length = 375.0;	/* arc length of each direction */
+	int max_steps = 1500;		/* steps in each direction */
+	double min_speed = 1.0e-3;	/* field magnitude below which the line stops, relative to the largest in the mesh */
+};
+
+/// <summary>
+/// Traces streamlines through the vector field of a Polyhedron. Not thread safe; use one tracer per thread.
+/// </summary>
+class StreamlineTracer {
+public:
+	TraceOptions options;
+	long long evaluations;		/* field samples taken so far, for comparing integrators */
+	TraceGuard* guard;			/* asked about every step if set; not owned */
+
+	StreamlineTracer(Polyhedron* poly, const TraceOptions& options);
+
+	/// <summary>
+	/// Traces from (x, y, z) along the field if direction is positive, against it otherwise, appending a segment per step.
+	/// </summary>
+	TraceEnd trace(double x, double y, double z, double direction, PolyLine& contour);
+
+	/// <summary>
+	/// Traces forward and then backward from (x, y, z), like extract_streamline always has, and appends the two
+	/// as one line through the seed, see join_at_seed.
+	/// </summary>
+	void trace_both(double x, double y, double z, PolyLine& contour);
+
+private:
+	FieldCursor cursor;
+	double direction;
+	double slowest;		/* min_speed in the units of the field */
+
+	/* unit direction of the field at (x, y), times direction */
+	bool direction_at(double x, double y, double d[2], TraceEnd* why);
+
+	/* one step of the Euler, RK2 or RK4 integrator from p, where the direction is k1 */
+	bool fixed_step(const double p[2], const double k1[2], double h, double next[2], TraceEnd* why);
+
+	/* one RK45 step from p, retried with shorter steps until its error is small enough; updates h for the next step */
+	bool adaptive_step(const double p[2], const double k1[2], double* h, double max_h, double next[2], double knext[2], TraceEnd* why);
+};
+
+/// <summary>
+/// Turns contour[begin, split), traced forward from a seed, and contour[split, end), traced backward from it,
+/// into one line from the far end of the backward part through the seed to the far end of the forward part.
+/// </summary>
+void join_at_seed(PolyLine& contour, size_t begin, size_t split);
+
+/// <summary>
+/// Many polylines in one block, by their points. Line i is points[first[i]] up to, not including, points[first[i + 1]],
+/// a segment between each two in a row; it has no points at all or at least two.
+/// Each point is stored once, where segments would store every inner point twice.
+/// </summary>
+struct StreamlineStore {
+	std::vector<icVector3> points;
+	std::vector<int> first;
+
+	StreamlineStore() : first(1, 0) {}
+
+	int size() const { return (int)first.size() - 1; }
+	int point_count(int line) const { return first[line + 1] - first[line]; }
+	const icVector3* line(int line) const { return points.data() + first[line]; }
+
+	void clear() { points.clear(); first.assign(1, 0); }
+
+	/// <summary>
+	/// Adds the segments of line, one line per run of segments that join end to start. An empty line is added as one empty line.
+	/// </summary>
+	void append(const PolyLine& line);
+
+	/// <summary>
+	/// Appends the segments of every line to out.
+	/// </summary>
+	void segments(PolyLine& out) const;
+};
+
+/// <summary>
+/// Traces forward and backward from every seed, like trace_both, on nthreads threads (all cores if 0).
+/// Line i of store is the line of seeds[i], even if it's empty, and is the same whatever the number of threads.
+/// </summary>
+void trace_streamlines(Polyhedron* poly, const TraceOptions& options, const std::vector<icVector3>& seeds,
+	StreamlineStore& store, int nthreads = 0);
+
+#endif /* __STREAMLINE_H__ */
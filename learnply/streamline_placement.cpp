@@ -0,0 +1,295 @@
+/*
+
+Evenly-spaced streamline placement
+
+*/
+
+#include <math.h>
+#include <deque>
+#include <vector>
+#include "polyhedron.h"
+#include "field_cursor.h"
+#include "streamline_placement.h"
+
+/******************************************************************************
+Points of the lines placed so far, bucketed into square cells the size of
+the separation. Each cell is a linked list through next, newest first, so
+dropping the newest points again is just popping list heads.
+******************************************************************************/
+
+class OccupancyGrid {
+public:
+	OccupancyGrid(const Polyhedron* poly, double cell_size);
+
+	int size() const { return (int)x.size(); }
+
+	void add(double px, double py, int line, double arc);
+
+	/// <summary>
+	/// Drops the newest points until only count are left.
+	/// </summary>
+	void truncate(int count);
+
+	/// <summary>
+	/// True if a point is closer than radius (at most the cell size) to (px, py). Points of the given line
+	/// only count if they're further than min_arc along it from arc, so a line isn't stopped by its own last steps.
+	/// </summary>
+	bool occupied(double px, double py, double radius, int line, double arc, double min_arc) const;
+
+	std::vector<double> x, y;
+
+private:
+	double origin[2];
+	double cell_size;
+	int ncells[2];
+	std::vector<int> head;		/* newest point of each cell, or -1 */
+	std::vector<int> next;		/* next older point in the same cell */
+	std::vector<int> line_of;
+	std::vector<double> arc_of;
+
+	int cell_of(double px, double py) const;
+};
+
+OccupancyGrid::OccupancyGrid(const Polyhedron* poly, double cell_size)
+{
+	this->cell_size = cell_size;
+	origin[0] = poly->minx;
+	origin[1] = poly->miny;
+	ncells[0] = (int)ceil((poly->maxx - poly->minx) / cell_size) + 1;
+	ncells[1] = (int)ceil((poly->maxy - poly->miny) / cell_size) + 1;
+	head.assign((size_t)ncells[0] * ncells[1], -1);
+}
+
+int OccupancyGrid::cell_of(double px, double py) const
+{
+	int cx = (int)floor((px - origin[0]) / cell_size);
+	int cy = (int)floor((py - origin[1]) / cell_size);
+	cx = cx < 0 ? 0 : (cx >= ncells[0] ? ncells[0] - 1 : cx);
+	cy = cy < 0 ? 0 : (cy >= ncells[1] ? ncells[1] - 1 : cy);
+	return cy * ncells[0] + cx;
+}
+
+void OccupancyGrid::add(double px, double py, int line, double arc)
+{
+	int cell = cell_of(px, py);
+	x.push_back(px);
+	y.push_back(py);
+	line_of.push_back(line);
+	arc_of.push_back(arc);
+	next.push_back(head[cell]);
+	head[cell] = (int)x.size() - 1;
+}
+
+void OccupancyGrid::truncate(int count)
+{
+	for (int i = size() - 1; i >= count; i--)
+		head[cell_of(x[i], y[i])] = next[i];
+	x.resize(count);
+	y.resize(count);
+	line_of.resize(count);
+	arc_of.resize(count);
+	next.resize(count);
+}
+
+bool OccupancyGrid::occupied(double px, double py, double radius, int line, double arc, double min_arc) const
+{
+	int cx = (int)floor((px - origin[0]) / cell_size);
+	int cy = (int)floor((py - origin[1]) / cell_size);
+	double r2 = radius * radius;
+
+	for (int j = cy - 1; j <= cy + 1; j++) {
+		if (j < 0 || j >= ncells[1])
+			continue;
+		for (int i = cx - 1; i <= cx + 1; i++) {
+			if (i < 0 || i >= ncells[0])
+				continue;
+			for (int k = head[j * ncells[0] + i]; k >= 0; k = next[k]) {
+				double dx = x[k] - px, dy = y[k] - py;
+				if (dx * dx + dy * dy >= r2)
+					continue;
+				if (line_of[k] != line || fabs(arc_of[k] - arc) > min_arc)
+					return true;
+			}
+		}
+	}
+	return false;
+}
+
+/******************************************************************************
+Ends a line within d_test of the others. Steps are cut into pieces no
+longer than half of d_test, and each piece end is checked and then added
+to the grid, so the line also sees itself.
+******************************************************************************/
+
+class SeparationGuard : public TraceGuard {
+public:
+	OccupancyGrid* grid;
+	double test_distance;
+	double self_arc;		/* how far back along its own line a point has to be to count */
+	int line;
+	double arc;				/* arc length of the last point added, negative going backward */
+	double direction;
+
+	virtual bool accept(const double from[2], const double to[2])
+	{
+		double dx = to[0] - from[0], dy = to[1] - from[1];
+		double len = sqrt(dx * dx + dy * dy);
+		int pieces = (int)ceil(len / (0.5 * test_distance));
+		if (pieces < 1)
+			pieces = 1;
+
+		for (int i = 1; i <= pieces; i++) {
+			double f = i / (double)pieces;
+			if (grid->occupied(from[0] + f * dx, from[1] + f * dy, test_distance, line, arc + direction * f * len, self_arc))
+				return false;
+		}
+		for (int i = 1; i <= pieces; i++) {
+			double f = i / (double)pieces;
+			grid->add(from[0] + f * dx, from[1] + f * dy, line, arc + direction * f * len);
+		}
+		arc += direction * len;
+		return true;
+	}
+};
+
+/******************************************************************************
+The placement itself. Lines are seeded beside in the order they were
+placed, so the mesh fills outwards from the first one. Once that runs dry
+(the flow doesn't connect everything, or the mesh is in pieces) the next
+vertex that is still clear of every line starts a new front.
+******************************************************************************/
+
+/* a line that made it in: points [first, end) of the grid */
+struct PlacedLine {
+	int first, end;
+};
+
+class Placer {
+public:
+	Placer(Polyhedron* poly, const TraceOptions& options, double d_sep, double d_test, double min_length, StreamlineStore& store);
+
+	void run();
+
+private:
+	Polyhedron* poly;
+	double d_sep;
+	double min_length;
+	StreamlineStore& store;
+
+	OccupancyGrid grid;
+	SeparationGuard guard;
+	StreamlineTracer tracer;
+	FieldCursor cursor;
+	std::vector<PlacedLine> placed;
+	PolyLine line;
+
+	/* traces a line from (x, y) if that's d_sep from every other line, and keeps it if it's long enough */
+	bool seed(double x, double y);
+};
+
+Placer::Placer(Polyhedron* poly, const TraceOptions& options, double d_sep, double d_test, double min_length, StreamlineStore& store)
+	: store(store), grid(poly, d_sep), tracer(poly, options), cursor(poly)
+{
+	this->poly = poly;
+	this->d_sep = d_sep;
+	this->min_length = min_length;
+
+	guard.grid = &grid;
+	guard.test_distance = d_test;
+	guard.self_arc = 2 * d_sep;
+	tracer.guard = &guard;
+}
+
+bool Placer::seed(double x, double y)
+{
+	if (grid.occupied(x, y, d_sep, -1, 0, 0))
+		return false;
+
+	int mark = grid.size();
+	int id = (int)placed.size();
+	double z = poly->vlist[0]->z;
+
+	grid.add(x, y, id, 0);
+	guard.line = id;
+	line.clear();
+	size_t split = 0;
+	for (int d = 1; d >= -1; d -= 2) {
+		guard.arc = 0;
+		guard.direction = d;
+		tracer.trace(x, y, z, d, line);
+		if (d == 1)
+			split = line.size();
+	}
+	join_at_seed(line, 0, split);
+
+	double length = 0;
+	for (size_t i = 0; i < line.size(); i++)
+		length += line[i].len;
+	if (length < min_length) {
+		grid.truncate(mark);
+		return false;
+	}
+
+	PlacedLine placed_line = { mark, grid.size() };
+	placed.push_back(placed_line);
+	store.append(line);
+	return true;
+}
+
+void Placer::run()
+{
+	/* pieces are at most d_test / 2 long, so every stride-th point is about d_sep along the line */
+	int stride = (int)floor(d_sep / (0.5 * guard.test_distance) + 0.5);
+	if (stride < 1)
+		stride = 1;
+
+	seed((poly->minx + poly->maxx) / 2, (poly->miny + poly->maxy) / 2);
+
+	size_t frontier = 0;
+	int next_vertex = 0;
+	for (;;) {
+		while (frontier < placed.size()) {
+			PlacedLine l = placed[frontier++];
+			for (int k = l.first; k < l.end; k += stride) {
+				double px = grid.x[k], py = grid.y[k];
+				icVector3 v;
+				if (!cursor.sample(px, py, &v))
+					continue;
+				double speed = sqrt(v.x * v.x + v.y * v.y);
+				if (speed == 0)
+					continue;
+				double nx = -v.y / speed * d_sep, ny = v.x / speed * d_sep;
+				seed(px + nx, py + ny);
+				seed(px - nx, py - ny);
+			}
+		}
+
+		while (next_vertex < poly->nverts && frontier == placed.size()) {
+			Vertex* v = poly->vlist[next_vertex++];
+			seed(v->x, v->y);
+		}
+		if (frontier == placed.size())
+			break;
+	}
+}
+
+void place_streamlines(Polyhedron* poly, const TraceOptions& options, const PlacementOptions& placement, StreamlineStore& store)
+{
+	store.clear();
+	if (poly->nquads == 0)
+		return;
+
+	double d_sep = placement.separation;
+	if (!(d_sep > 0))
+		d_sep = fmax(poly->maxx - poly->minx, poly->maxy - poly->miny) / 40;
+	double d_test = placement.test_ratio * d_sep;
+
+	/* no step may be longer than d_test, or it could hop over a line */
+	TraceOptions capped = options;
+	capped.step = fmin(capped.step, d_test);
+	capped.max_step = fmin(capped.max_step, d_test);
+	capped.min_step = fmin(capped.min_step, d_test);
+
+	Placer placer(poly, capped, d_sep, d_test, placement.min_length * d_sep, store);
+	placer.run();
+}
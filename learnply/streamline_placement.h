@@ -0,0 +1,35 @@
+/*
+
+Evenly-spaced streamline placement
+
+Jobard and Lefer's method: new lines are seeded d_sep to either side of
+the lines already placed, and a line ends once it gets within d_test of
+another one (or of itself, further along). Every point placed goes into a
+grid of d_sep sized cells, so a distance check only looks at the 3x3 cells
+around the point, however many lines there are.
+
+*/
+
+#ifndef __STREAMLINE_PLACEMENT_H__
+#define __STREAMLINE_PLACEMENT_H__
+
+#include "streamline.h"
+
+class Polyhedron;
+
+/// <summary>
+/// How densely to place lines. Distances are in mesh units.
+/// </summary>
+struct PlacementOptions {
+	double separation = 0;		/* d_sep; 0 picks 1/40 of the longer side of the mesh */
+	double test_ratio = 0.5;	/* d_test = test_ratio * d_sep */
+	double min_length = 1.0;	/* lines shorter than this many d_sep are dropped */
+};
+
+/// <summary>
+/// Fills store with evenly spaced streamlines covering the whole mesh, including parts the first line's
+/// neighbors never reach. The steps of options are capped at d_test so no step can jump past a line.
+/// </summary>
+void place_streamlines(Polyhedron* poly, const TraceOptions& options, const PlacementOptions& placement, StreamlineStore& store);
+
+#endif /* __STREAMLINE_PLACEMENT_H__ */
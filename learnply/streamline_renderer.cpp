@@ -0,0 +1,82 @@
+/*
+
+Batched drawing of a StreamlineStore
+
+*/
+
+#include "streamline.h"
+#include "streamline_renderer.h"
+
+StreamlineRenderer::StreamlineRenderer()
+	: uploaded(false), use_buffers(false), buffer(0)
+{
+}
+
+void StreamlineRenderer::set_lines(const StreamlineStore& lines)
+{
+	points.resize(3 * lines.points.size());
+	for (size_t i = 0; i < lines.points.size(); i++) {
+		points[3 * i] = (float)lines.points[i].x;
+		points[3 * i + 1] = (float)lines.points[i].y;
+		points[3 * i + 2] = (float)lines.points[i].z;
+	}
+
+	/* empty lines would be draws of nothing, leave them out */
+	first.clear();
+	counts.clear();
+	for (int i = 0; i < lines.size(); i++)
+		if (lines.point_count(i) > 0) {
+			first.push_back(lines.first[i]);
+			counts.push_back(lines.point_count(i));
+		}
+	uploaded = false;
+}
+
+void StreamlineRenderer::draw(float width, float R, float G, float B)
+{
+	if (counts.empty())
+		return;
+
+	if (!uploaded) {
+		use_buffers = GLEW_VERSION_1_5 != 0;
+		if (use_buffers) {
+			if (buffer == 0)
+				glGenBuffers(1, &buffer);
+			glBindBuffer(GL_ARRAY_BUFFER, buffer);
+			glBufferData(GL_ARRAY_BUFFER, points.size() * sizeof(float), points.data(), GL_STATIC_DRAW);
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+		}
+		uploaded = true;
+	}
+
+	glDisable(GL_LIGHTING);
+	glEnable(GL_LINE_SMOOTH);
+	glHint(GL_LINE_SMOOTH_HINT, GL_NICEST);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glLineWidth(width);
+	glColor3f(R, G, B);
+
+	glEnableClientState(GL_VERTEX_ARRAY);
+	if (use_buffers)
+		glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	glVertexPointer(3, GL_FLOAT, 0, use_buffers ? 0 : points.data());
+	if (GLEW_VERSION_1_4)
+		glMultiDrawArrays(GL_LINE_STRIP, first.data(), counts.data(), (GLsizei)counts.size());
+	else
+		for (size_t i = 0; i < counts.size(); i++)
+			glDrawArrays(GL_LINE_STRIP, first[i], counts[i]);
+	if (use_buffers)
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glDisableClientState(GL_VERTEX_ARRAY);
+
+	glDisable(GL_BLEND);
+}
+
+void StreamlineRenderer::release()
+{
+	if (buffer != 0)
+		glDeleteBuffers(1, &buffer);
+	buffer = 0;
+	uploaded = false;
+}
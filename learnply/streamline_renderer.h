@@ -0,0 +1,52 @@
+/*
+
+Batched drawing of a StreamlineStore
+
+The points of every line go to OpenGL once, in one array, and all the
+lines are drawn with a single glMultiDrawArrays of line strips rather than
+a vertex call per segment end. The array lives in a buffer object where
+the driver has them (OpenGL 1.5) and is drawn from client memory otherwise.
+
+*/
+
+#ifndef __STREAMLINE_RENDERER_H__
+#define __STREAMLINE_RENDERER_H__
+
+#include <vector>
+#include "gl/glew.h"
+
+struct StreamlineStore;
+
+class StreamlineRenderer {
+public:
+	StreamlineRenderer();
+
+	/// <summary>
+	/// Copies the lines to draw, replacing those there were. They are uploaded by the next draw.
+	/// </summary>
+	void set_lines(const StreamlineStore& lines);
+
+	/// <summary>
+	/// Draws every line, smoothed and blended, in one call.
+	/// </summary>
+	void draw(float width, float R, float G, float B);
+
+	/// <summary>
+	/// Frees the buffer object. Needs the OpenGL context it was made in.
+	/// </summary>
+	void release();
+
+private:
+	StreamlineRenderer(const StreamlineRenderer&);
+	StreamlineRenderer& operator=(const StreamlineRenderer&);
+
+	std::vector<float> points;		/* x, y, z of every point of every line */
+	std::vector<GLint> first;		/* of each line with points, into points / 3 */
+	std::vector<GLsizei> counts;
+
+	bool uploaded;
+	bool use_buffers;
+	GLuint buffer;
+};
+
+#endif /* __STREAMLINE_RENDERER_H__ */
@@ -0,0 +1,115 @@
+/*
+
+Implicit topology for regular quad meshes
+
+*/
+
+#include <math.h>
+#include "polyhedron.h"
+#include "structured_grid.h"
+
+StructuredGrid* StructuredGrid::detect(Polyhedron* poly)
+{
+	int nverts = poly->nverts;
+	int nquads = poly->nquads;
+	if (nverts < 4 || nquads < 1)
+		return NULL;
+
+	for (int i = 0; i < nverts; i++)
+		poly->vlist[i]->index = i;
+
+	/* the first face spans the first two rows and gives the row length */
+	Quad* first = poly->qlist[0];
+	int nx = first->verts[3]->index;
+	if (first->verts[0]->index != 0 || nx < 2 || nverts % nx != 0)
+		return NULL;
+	int ny = nverts / nx;
+	if (ny < 2 || nquads != (nx - 1) * (ny - 1))
+		return NULL;
+
+	/* spacing from the far corners, so rounding in the file isn't multiplied across the grid */
+	Vertex* v0 = poly->vlist[0];
+	Vertex* v1 = poly->vlist[nx - 1];
+	Vertex* vn = poly->vlist[(ny - 1) * nx];
+	double sx = (v1->x - v0->x) / (nx - 1);
+	double sy = (vn->y - v0->y) / (ny - 1);
+	if (sx == 0 || sy == 0 || v1->y != v0->y || vn->x != v0->x)
+		return NULL;
+
+	/* the files are written with a handful of decimals, so allow for rounding */
+	double tol_x = fabs(sx) * 1.0e-4;
+	double tol_y = fabs(sy) * 1.0e-4;
+	for (int row = 0; row < ny; row++) {
+		double y = v0->y + row * sy;
+		for (int col = 0; col < nx; col++) {
+			Vertex* v = poly->vlist[row * nx + col];
+			if (fabs(v->x - (v0->x + col * sx)) > tol_x || fabs(v->y - y) > tol_y || v->z != v0->z)
+				return NULL;
+		}
+	}
+
+	for (int i = 0; i < nquads; i++) {
+		int k = (i / (nx - 1)) * nx + i % (nx - 1);
+		Vertex** verts = poly->qlist[i]->verts;
+		if (verts[0]->index != k || verts[1]->index != k + 1 ||
+			verts[2]->index != k + nx + 1 || verts[3]->index != k + nx)
+			return NULL;
+	}
+
+	StructuredGrid* grid = new StructuredGrid;
+	grid->nx = nx;
+	grid->ny = ny;
+	grid->origin[0] = v0->x;
+	grid->origin[1] = v0->y;
+	grid->spacing[0] = sx;
+	grid->spacing[1] = sy;
+	grid->z = v0->z;
+
+	return grid;
+}
+
+int StructuredGrid::cell_vertex(int cell, int corner) const
+{
+	int k = (cell / (nx - 1)) * nx + cell % (nx - 1);
+	switch (corner) {
+	case 0: return k;
+	case 1: return k + 1;
+	case 2: return k + nx + 1;
+	default: return k + nx;
+	}
+}
+
+int StructuredGrid::cell_neighbor(int cell, int side) const
+{
+	int col = cell % (nx - 1);
+	int row = cell / (nx - 1);
+	switch (side) {
+	case 0: return row > 0 ? cell - (nx - 1) : -1;
+	case 1: return col < nx - 2 ? cell + 1 : -1;
+	case 2: return row < ny - 2 ? cell + (nx - 1) : -1;
+	default: return col > 0 ? cell - 1 : -1;
+	}
+}
+
+bool StructuredGrid::locate(double x, double y, int* cell, double* s, double* t) const
+{
+	double fx = (x - origin[0]) / spacing[0];
+	double fy = (y - origin[1]) / spacing[1];
+	/* points on the far boundary can still land a hair past it */
+	const double tol = 1.0e-9 * (nx + ny);
+	if (!(fx >= -tol && fx <= nx - 1 + tol && fy >= -tol && fy <= ny - 1 + tol))
+		return false;
+
+	/* points on the last row or column belong to the cell before it */
+	int col = fx > 0 ? (int)fx : 0;
+	int row = fy > 0 ? (int)fy : 0;
+	if (col > nx - 2)
+		col = nx - 2;
+	if (row > ny - 2)
+		row = ny - 2;
+
+	*cell = row * (nx - 1) + col;
+	*s = fmin(fmax(fx - col, 0.0), 1.0);
+	*t = fmin(fmax(fy - row, 0.0), 1.0);
+	return true;
+}
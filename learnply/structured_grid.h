@@ -0,0 +1,55 @@
+/*
+
+Implicit topology for regular quad meshes
+
+The boids, scalar_data and vector_data files are all NxM lattices written
+row by row, with face (row, col) made of the vertices k, k+1, k+N+1, k+N
+where k = row*N + col. For those the neighbors of a vertex or cell follow
+from its index, so no Edge objects or vertex rings are needed.
+
+*/
+
+#ifndef __STRUCTURED_GRID_H__
+#define __STRUCTURED_GRID_H__
+
+class Polyhedron;
+
+/// <summary>
+/// A regular lattice detected in a Polyhedron. Vertex and cell indices are those of vlist and qlist.
+/// </summary>
+class StructuredGrid {
+public:
+	int nx, ny;				/* vertices per row, number of rows */
+	double origin[2];		/* position of vertex 0 */
+	double spacing[2];		/* step along a row and from one row to the next; either may be negative */
+	double z;
+
+	/// <summary>
+	/// Returns the lattice if poly is one, otherwise NULL. Also numbers the vertices of poly.
+	/// </summary>
+	static StructuredGrid* detect(Polyhedron* poly);
+
+	int cells_x() const { return nx - 1; }
+	int cells_y() const { return ny - 1; }
+	int vertex(int col, int row) const { return row * nx + col; }
+	int cell(int col, int row) const { return row * (nx - 1) + col; }
+
+	/// <summary>
+	/// Index of a corner of a cell, in the same order as Quad::verts.
+	/// </summary>
+	int cell_vertex(int cell, int corner) const;
+
+	/// <summary>
+	/// The cell across side j of a cell, i.e. across the edge from corner j to corner j+1 like Quad::edges[j].
+	/// </summary>
+	/// <returns>-1 on the boundary.</returns>
+	int cell_neighbor(int cell, int side) const;
+
+	/// <summary>
+	/// Finds the cell containing (x, y) and the position inside it, s along a row and t across rows, both in [0, 1].
+	/// </summary>
+	/// <returns>False if the point is outside the grid.</returns>
+	bool locate(double x, double y, int* cell, double* s, double* t) const;
+};
+
+#endif /* __STRUCTURED_GRID_H__ */
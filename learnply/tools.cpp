@@ -0,0 +1,345 @@
+/*
+
+Command line tools run instead of the viewer
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <errno.h>
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+#include "ply.h"
+#include "polyhedron.h"
+#include "boids.h"
+#include "topo_cache.h"
+#include "lic.h"
+#include "ibfv.h"
+#include "tools.h"
+
+/******************************************************************************
+Read a PLY file and write it back out in another format. Writing goes to a
+temporary file first so that converting in place can't lose the input.
+******************************************************************************/
+static int convert_ply(const char* in_path, const char* out_path, int file_type)
+{
+	FILE* in = fopen(in_path, "rb");
+	if (in == NULL) {
+		fprintf(stderr, "Could not open %s.\n", in_path);
+		return 1;
+	}
+	Polyhedron* poly = new Polyhedron(in);
+
+	std::string tmp_path = std::string(out_path) + ".tmp";
+	FILE* out = fopen(tmp_path.c_str(), "wb");
+	if (out == NULL) {
+		fprintf(stderr, "Could not write %s.\n", tmp_path.c_str());
+		poly->finalize();
+		delete poly;
+		return 1;
+	}
+	bool written = poly->write_file(out, file_type);
+	poly->finalize();
+	delete poly;
+
+	/* a short write must not replace the input */
+	if (!written) {
+		fprintf(stderr, "Could not write %s.\n", tmp_path.c_str());
+		remove(tmp_path.c_str());
+		return 1;
+	}
+	remove(out_path);
+	if (rename(tmp_path.c_str(), out_path) != 0) {
+		fprintf(stderr, "Could not replace %s.\n", out_path);
+		return 1;
+	}
+	return 0;
+}
+
+/* parse "2,4,8" into horizons; false on anything that isn't a number */
+static bool parse_horizons(const char* list, std::vector<float>& horizons)
+{
+	const char* p = list;
+	while (*p) {
+		char* end;
+		float t = strtof(p, &end);
+		if (end == p || isnan(t) || (*end != ',' && *end != '\0'))
+			return false;
+		horizons.push_back(t);
+		p = *end ? end + 1 : end;
+	}
+	return !horizons.empty();
+}
+
+/* create dir and any missing parents, like the transformer's Directory.CreateDirectory */
+static bool make_directory(const std::string& dir)
+{
+	for (size_t i = 1; i <= dir.size(); i++) {
+		if (i < dir.size() && dir[i] != '/' && dir[i] != '\\')
+			continue;
+		std::string part = dir.substr(0, i);
+#ifdef _WIN32
+		int made = _mkdir(part.c_str());
+#else
+		int made = mkdir(part.c_str(), 0777);
+#endif
+		if (made != 0 && errno != EEXIST && i == dir.size())
+			return false;
+	}
+	return true;
+}
+
+/******************************************************************************
+Rasterize a raw log for several time horizons in one pass, replacing a run of
+the transformer per -t value. Writes <dir>/<name><t>.boids.ply for each horizon
+and <dir>/<name>.boids.ply for the whole log, as the transformer named them.
+******************************************************************************/
+static int slice_log(int argc, char* argv[])
+{
+	const char* log_path = NULL;
+	std::string out_dir = ".";
+	int grid_size = BOIDS_GRID_SIZE;
+	std::vector<float> horizons;
+
+	for (int i = 2; i < argc; i++) {
+		if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+			out_dir = argv[++i];
+		else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+			grid_size = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+			if (!parse_horizons(argv[++i], horizons)) {
+				fprintf(stderr, "Could not interpret the time list \"%s\".\n", argv[i]);
+				return 2;
+			}
+		}
+		else if (argv[i][0] != '-' && log_path == NULL)
+			log_path = argv[i];
+		else {
+			fprintf(stderr, "usage: learnply -slice log.boids [-o dir] [-s resolution] [-t t1,t2,...]\n");
+			return 2;
+		}
+	}
+	if (log_path == NULL || grid_size < 2) {
+		fprintf(stderr, "usage: learnply -slice log.boids [-o dir] [-s resolution] [-t t1,t2,...]\n");
+		return 2;
+	}
+	if (!make_directory(out_dir)) {
+		fprintf(stderr, "Could not create the output directory %s.\n", out_dir.c_str());
+		return 1;
+	}
+
+	BoidsLog log;
+	if (!read_boids_log(log_path, log)) {
+		fprintf(stderr, "Could not read %s.\n", log_path);
+		return 1;
+	}
+
+	/* the whole log goes last, under the plain name */
+	horizons.push_back(INFINITY);
+	std::vector<BoidsGrid> grids;
+	rasterize_boids(log, BOIDS_KNOWN_BOUNDS, grid_size, horizons, grids);
+
+	std::string name = log_path;
+	size_t slash = name.find_last_of("/\\");
+	if (slash != std::string::npos)
+		name = name.substr(slash + 1);
+	if (name.size() > 6 && name.compare(name.size() - 6, 6, ".boids") == 0)
+		name.resize(name.size() - 6);
+
+	int result = 0;
+	for (size_t h = 0; h < horizons.size(); h++) {
+		char suffix[64] = "";
+		if (h + 1 < horizons.size())
+			sprintf(suffix, "%g", horizons[h]);
+		std::string path = out_dir + "/" + name + suffix + ".boids.ply";
+		if (!write_boids_ply(grids[h], path.c_str())) {
+			fprintf(stderr, "Could not write %s.\n", path.c_str());
+			result = 1;
+		}
+	}
+	return result;
+}
+
+/* binary PGM, which is top row first where the image is bottom row first */
+static bool write_pgm(const char* path, const std::vector<unsigned char>& image, int width, int height)
+{
+	FILE* out = fopen(path, "wb");
+	if (out == NULL)
+		return false;
+	bool ok = fprintf(out, "P5\n%d %d\n255\n", width, height) > 0;
+	for (int row = height - 1; row >= 0 && ok; row--)
+		ok = fwrite(&image[(size_t)row * width], 1, width, out) == (size_t)width;
+	ok = (fclose(out) == 0) && ok;
+	return ok;
+}
+
+/* a PLY file or a raw log, initialized; NULL if it can't be read */
+static Polyhedron* load_mesh(const char* path)
+{
+	size_t len = strlen(path);
+	Polyhedron* poly;
+	if (len > 6 && strcmp(path + len - 6, ".boids") == 0)
+		poly = load_boids(path);
+	else {
+		FILE* in = fopen(path, "rb");
+		poly = in ? new Polyhedron(in) : NULL;
+	}
+	if (poly == NULL) {
+		fprintf(stderr, "Could not open %s.\n", path);
+		return NULL;
+	}
+	initialize_cached(poly, path);
+	return poly;
+}
+
+/******************************************************************************
+Compute the LIC of a mesh without opening a window and write it as a PGM
+image, printing how long the LIC itself took.
+******************************************************************************/
+static int lic_image(int argc, char* argv[])
+{
+	const char* usage = "usage: learnply -lic in.ply out.pgm [-s size] [-k kernel]\n";
+	const char* in_path = NULL;
+	const char* out_path = NULL;
+	LicOptions options;
+
+	for (int i = 2; i < argc; i++) {
+		if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+			options.width = options.height = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-k") == 0 && i + 1 < argc)
+			options.kernel = atoi(argv[++i]);
+		else if (argv[i][0] != '-' && in_path == NULL)
+			in_path = argv[i];
+		else if (argv[i][0] != '-' && out_path == NULL)
+			out_path = argv[i];
+		else {
+			fprintf(stderr, "%s", usage);
+			return 2;
+		}
+	}
+	if (in_path == NULL || out_path == NULL) {
+		fprintf(stderr, "%s", usage);
+		return 2;
+	}
+
+	Polyhedron* poly = load_mesh(in_path);
+	if (poly == NULL)
+		return 1;
+
+	std::vector<unsigned char> image;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	bool ok = compute_lic(poly, options, image);
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	poly->finalize();
+	delete poly;
+	if (!ok) {
+		fprintf(stderr, "Could not compute the LIC of %s.\n", in_path);
+		return 1;
+	}
+	printf("LIC of %s: %d x %d in %.1f ms\n", in_path, options.width, options.height, ms);
+
+	if (!write_pgm(out_path, image, options.width, options.height)) {
+		fprintf(stderr, "Could not write %s.\n", out_path);
+		return 1;
+	}
+	return 0;
+}
+
+/******************************************************************************
+Run the IBFV animation of a mesh without opening a window, seen straight on
+as the viewer first shows it, and write the last frame as a PGM image.
+Prints the time per frame, which is all the engine costs the viewer but
+the one upload of the frame.
+******************************************************************************/
+static int ibfv_image(int argc, char* argv[])
+{
+	const char* usage = "usage: learnply -ibfv in.ply out.pgm [-s size] [-n frames]\n";
+	const char* in_path = NULL;
+	const char* out_path = NULL;
+	int size = 800, frames = 100;
+
+	for (int i = 2; i < argc; i++) {
+		if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+			size = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+			frames = atoi(argv[++i]);
+		else if (argv[i][0] != '-' && in_path == NULL)
+			in_path = argv[i];
+		else if (argv[i][0] != '-' && out_path == NULL)
+			out_path = argv[i];
+		else {
+			fprintf(stderr, "%s", usage);
+			return 2;
+		}
+	}
+	if (in_path == NULL || out_path == NULL || size < 2 || frames < 1) {
+		fprintf(stderr, "%s", usage);
+		return 2;
+	}
+
+	Polyhedron* poly = load_mesh(in_path);
+	if (poly == NULL)
+		return 1;
+
+	/* the mesh's bounding square fills the viewport, like an orthographic glOrtho over it */
+	poly->calc_bounding_box();
+	double cx = (poly->minx + poly->maxx) / 2, cy = (poly->miny + poly->maxy) / 2;
+	double half = fmax(poly->maxx - poly->minx, poly->maxy - poly->miny) / 2;
+	double modelview[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+	double projection[16] = { 1 / half, 0, 0, 0, 0, 1 / half, 0, 0, 0, 0, -1, 0, -cx / half, -cy / half, 0, 1 };
+	int viewport[4] = { 0, 0, size, size };
+
+	IbfvEngine engine;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	engine.set_view(poly, modelview, projection, viewport);
+	double setup = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	start = std::chrono::steady_clock::now();
+	for (int i = 0; i < frames; i++)
+		engine.step();
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	poly->finalize();
+	delete poly;
+	printf("IBFV of %s: %d x %d, warp table in %.1f ms, %.2f ms per frame\n", in_path, size, size, setup, ms / frames);
+
+	std::vector<unsigned char> image(engine.image(), engine.image() + (size_t)size * size);
+	if (!write_pgm(out_path, image, size, size)) {
+		fprintf(stderr, "Could not write %s.\n", out_path);
+		return 1;
+	}
+	return 0;
+}
+
+int run_tool(int argc, char* argv[])
+{
+	if (argc < 2 || argv[1][0] != '-')
+		return -1;
+
+	if (strcmp(argv[1], "-slice") == 0)
+		return slice_log(argc, argv);
+	if (strcmp(argv[1], "-lic") == 0)
+		return lic_image(argc, argv);
+	if (strcmp(argv[1], "-ibfv") == 0)
+		return ibfv_image(argc, argv);
+
+	int file_type;
+	if (strcmp(argv[1], "-binary") == 0)
+		file_type = PLY_BINARY_LE;
+	else if (strcmp(argv[1], "-ascii") == 0)
+		file_type = PLY_ASCII;
+	else
+		return -1;
+
+	if (argc < 3 || argc > 4) {
+		fprintf(stderr, "usage: learnply %s in.ply [out.ply]\n", argv[1]);
+		return 2;
+	}
+	return convert_ply(argv[2], argc == 4 ? argv[3] : argv[2], file_type);
+}
@@ -0,0 +1,21 @@
+/*
+
+Command line tools run instead of the viewer
+
+*/
+
+#ifndef __TOOLS_H__
+#define __TOOLS_H__
+
+/// <summary>
+/// Runs the batch tool named by argv[1], if any:
+/// <c>-binary in.ply [out.ply]</c> rewrites a PLY file as binary_little_endian,
+/// <c>-ascii in.ply [out.ply]</c> rewrites it as ASCII. Without an output path the input is replaced.
+/// <c>-slice log.boids [-o dir] [-s resolution] [-t t1,t2,...]</c> rasterizes a raw log for every time horizon in one pass.
+/// <c>-lic in.ply out.pgm [-s size] [-k kernel]</c> writes the LIC of a mesh (or raw log) as a PGM image.
+/// <c>-ibfv in.ply out.pgm [-s size] [-n frames]</c> runs the IBFV animation headless, timing it, and writes its last frame.
+/// </summary>
+/// <returns>The process exit code, or -1 if argv doesn't ask for a tool and the viewer should start.</returns>
+int run_tool(int argc, char* argv[]);
+
+#endif /* __TOOLS_H__ */
@@ -0,0 +1,325 @@
+/*
+
+Cached topology for Polyhedron::initialize
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "polyhedron.h"
+#include "mapped_file.h"
+#include "topo_cache.h"
+
+/*
+Layout of a .topo file. Sections follow the header in this order, widest
+type first so that every section of the mapped file is naturally aligned:
+
+  double  vertex normals [nverts][3]
+  double  quad normals   [nquads][3]
+  double  edge lengths   [nedges]
+  float   quad areas     [nquads]
+  int32   edge verts     [nedges][2]
+  int32   quad edges     [nquads][4]
+  int32   vertex quads   offsets [nverts + 1], then indices, in ring order
+  int32   vertex edges   offsets [nverts + 1], then indices
+  int32   edge quads     offsets [nedges + 1], then indices
+*/
+struct TopoHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t orientation;
+	uint64_t source_hash;
+	uint64_t source_size;
+	int32_t nverts, nquads, nedges;
+	int32_t nvertex_quads, nvertex_edges, nedge_quads;
+	double center[3];
+	double radius;
+	double area;
+};
+
+static const char TOPO_MAGIC[8] = { 'L', 'P', 'T', 'O', 'P', 'O', '\0', '\0' };
+
+static std::string cache_path(const char* source_path)
+{
+	return std::string(source_path) + ".topo";
+}
+
+/******************************************************************************
+FNV-1a over the source file, eight bytes at a time so that hashing a large
+PLY costs a small fraction of parsing it.
+
+Exit:
+  returns false if the source can't be read
+******************************************************************************/
+bool hash_source(const char* source_path, uint64_t* hash, uint64_t* size)
+{
+	MappedFile file;
+	if (!file.open(source_path))
+		return false;
+
+	const unsigned char* p = (const unsigned char*)file.data();
+	size_t n = file.size();
+	uint64_t h = 14695981039346656037ULL;
+	const uint64_t prime = 1099511628211ULL;
+
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		uint64_t word;
+		memcpy(&word, p + i, 8);
+		h = (h ^ word) * prime;
+	}
+	for (; i < n; i++)
+		h = (h ^ p[i]) * prime;
+
+	*hash = h;
+	*size = n;
+	return true;
+}
+
+static size_t expected_size(const TopoHeader* h)
+{
+	size_t nv = (size_t)h->nverts, nq = (size_t)h->nquads, ne = (size_t)h->nedges;
+	return sizeof(TopoHeader)
+		+ sizeof(double) * (nv * 3 + nq * 3 + ne)
+		+ sizeof(float) * nq
+		+ sizeof(int32_t) * (ne * 2 + nq * 4)
+		+ sizeof(int32_t) * (nv + 1 + (size_t)h->nvertex_quads)
+		+ sizeof(int32_t) * (nv + 1 + (size_t)h->nvertex_edges)
+		+ sizeof(int32_t) * (ne + 1 + (size_t)h->nedge_quads);
+}
+
+/* CSR offsets must start at 0, never decrease and end at the index count */
+static bool valid_offsets(const int32_t* offsets, int n, int total)
+{
+	if (offsets[0] != 0 || offsets[n] != total)
+		return false;
+	for (int i = 0; i < n; i++)
+		if (offsets[i + 1] < offsets[i])
+			return false;
+	return true;
+}
+
+static bool valid_indices(const int32_t* index, size_t n, int limit)
+{
+	for (size_t i = 0; i < n; i++)
+		if (index[i] < 0 || index[i] >= limit)
+			return false;
+	return true;
+}
+
+bool read_topology_cache(Polyhedron* poly, const char* source_path)
+{
+	MappedFile file;
+	if (!file.open(cache_path(source_path).c_str()) || file.size() < sizeof(TopoHeader))
+		return false;
+
+	const TopoHeader* h = (const TopoHeader*)file.data();
+	if (memcmp(h->magic, TOPO_MAGIC, sizeof(TOPO_MAGIC)) != 0 || h->version != TOPO_CACHE_VERSION)
+		return false;
+	if (h->nverts != poly->nverts || h->nquads != poly->nquads || h->nedges < 0 ||
+		h->nvertex_quads < 0 || h->nvertex_edges < 0 || h->nedge_quads < 0 ||
+		file.size() != expected_size(h))
+		return false;
+
+	uint64_t hash, size;
+	if (!hash_source(source_path, &hash, &size) || hash != h->source_hash || size != h->source_size)
+		return false;
+
+	int nverts = h->nverts, nquads = h->nquads, nedges = h->nedges;
+
+	const double* vertex_normals = (const double*)(h + 1);
+	const double* quad_normals = vertex_normals + 3 * (size_t)nverts;
+	const double* edge_lengths = quad_normals + 3 * (size_t)nquads;
+	const float* quad_areas = (const float*)(edge_lengths + nedges);
+	const int32_t* edge_verts = (const int32_t*)(quad_areas + nquads);
+	const int32_t* quad_edges = edge_verts + 2 * (size_t)nedges;
+	const int32_t* vq_offsets = quad_edges + 4 * (size_t)nquads;
+	const int32_t* vq_index = vq_offsets + nverts + 1;
+	const int32_t* ve_offsets = vq_index + h->nvertex_quads;
+	const int32_t* ve_index = ve_offsets + nverts + 1;
+	const int32_t* eq_offsets = ve_index + h->nvertex_edges;
+	const int32_t* eq_index = eq_offsets + nedges + 1;
+
+	/* a damaged cache must not turn into wild pointers */
+	if (!valid_offsets(vq_offsets, nverts, h->nvertex_quads) ||
+		!valid_offsets(ve_offsets, nverts, h->nvertex_edges) ||
+		!valid_offsets(eq_offsets, nedges, h->nedge_quads) ||
+		!valid_indices(edge_verts, 2 * (size_t)nedges, nverts) ||
+		!valid_indices(quad_edges, 4 * (size_t)nquads, nedges) ||
+		!valid_indices(vq_index, h->nvertex_quads, nquads) ||
+		!valid_indices(ve_index, h->nvertex_edges, nedges) ||
+		!valid_indices(eq_index, h->nedge_quads, nquads))
+		return false;
+
+	/* the cache is good; from here on this is what initialize() would have built */
+	poly->selected_quad = -1;
+	poly->selected_vertex = -1;
+
+	for (int i = 0; i < nquads; i++)
+		poly->qlist[i]->index = i;
+
+	poly->nedges = poly->max_edges = nedges;
+	poly->elist = new Edge *[nedges > 0 ? nedges : 1];
+	poly->arena.reserve(sizeof(Edge) * (size_t)nedges +
+		sizeof(Quad*) * ((size_t)h->nedge_quads + 2 * (size_t)nedges + (size_t)h->nvertex_quads) +
+		sizeof(Edge*) * (size_t)h->nvertex_edges);
+	for (int i = 0; i < nedges; i++) {
+		Edge* e = poly->new_edge();
+		e->index = i;
+		e->verts[0] = poly->vlist[edge_verts[2 * i]];
+		e->verts[1] = poly->vlist[edge_verts[2 * i + 1]];
+		e->length = edge_lengths[i];
+
+		/* same allocation as create_edges: room for at least two quads */
+		int n = eq_offsets[i + 1] - eq_offsets[i];
+		e->nquads = n;
+		e->quads = poly->new_quad_ring(n < 2 ? 2 : n);
+		for (int j = 0; j < n; j++)
+			e->quads[j] = poly->qlist[eq_index[eq_offsets[i] + j]];
+		poly->elist[i] = e;
+	}
+
+	for (int i = 0; i < nquads; i++) {
+		Quad* q = poly->qlist[i];
+		q->index = i;
+		for (int j = 0; j < 4; j++)
+			q->edges[j] = poly->elist[quad_edges[4 * i + j]];
+		q->normal.set(quad_normals[3 * i], quad_normals[3 * i + 1], quad_normals[3 * i + 2]);
+		q->area = quad_areas[i];
+	}
+
+	for (int i = 0; i < nverts; i++) {
+		Vertex* v = poly->vlist[i];
+		v->index = i;
+
+		int n = vq_offsets[i + 1] - vq_offsets[i];
+		v->nquads = v->max_quads = n;
+		v->quads = poly->new_quad_ring(n);
+		for (int j = 0; j < n; j++)
+			v->quads[j] = poly->qlist[vq_index[vq_offsets[i] + j]];
+
+		n = ve_offsets[i + 1] - ve_offsets[i];
+		v->nedges = v->max_edges = n;
+		v->edges = poly->new_edge_ring(n);
+		for (int j = 0; j < n; j++)
+			v->edges[j] = poly->elist[ve_index[ve_offsets[i] + j]];
+
+		v->normal.set(vertex_normals[3 * i], vertex_normals[3 * i + 1], vertex_normals[3 * i + 2]);
+	}
+
+	poly->center.set(h->center[0], h->center[1], h->center[2]);
+	poly->radius = h->radius;
+	poly->area = h->area;
+	poly->orientation = (unsigned char)h->orientation;
+	poly->attributes.gather(poly->vlist, poly->nverts);
+	poly->calc_bounding_box();
+	poly->calc_scalar_stats();
+	return true;
+}
+
+bool write_topology_cache(Polyhedron* poly, const char* source_path)
+{
+	if (poly->grid)
+		return false;
+
+	TopoHeader h;
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, TOPO_MAGIC, sizeof(TOPO_MAGIC));
+	h.version = TOPO_CACHE_VERSION;
+	h.orientation = poly->orientation;
+	if (!hash_source(source_path, &h.source_hash, &h.source_size))
+		return false;
+
+	int nverts = poly->nverts, nquads = poly->nquads, nedges = poly->nedges;
+	h.nverts = nverts;
+	h.nquads = nquads;
+	h.nedges = nedges;
+	for (int i = 0; i < 3; i++)
+		h.center[i] = poly->center.entry[i];
+	h.radius = poly->radius;
+	h.area = poly->area;
+
+	std::vector<double> doubles;
+	doubles.reserve(3 * (size_t)nverts + 3 * (size_t)nquads + nedges);
+	for (int i = 0; i < nverts; i++)
+		doubles.insert(doubles.end(), poly->vlist[i]->normal.entry, poly->vlist[i]->normal.entry + 3);
+	for (int i = 0; i < nquads; i++)
+		doubles.insert(doubles.end(), poly->qlist[i]->normal.entry, poly->qlist[i]->normal.entry + 3);
+	for (int i = 0; i < nedges; i++)
+		doubles.push_back(poly->elist[i]->length);
+
+	std::vector<float> areas(nquads);
+	for (int i = 0; i < nquads; i++)
+		areas[i] = poly->qlist[i]->area;
+
+	/* every quad is in 4 vertex rings and every edge in 2, and edges have at most 2 quads in a manifold */
+	std::vector<int32_t> ints;
+	ints.reserve(2 * (size_t)nedges + 4 * (size_t)nquads + 2 * ((size_t)nverts + 1) + 4 * (size_t)nquads
+		+ 2 * (size_t)nedges + (size_t)nedges + 1 + 2 * (size_t)nedges);
+	for (int i = 0; i < nedges; i++) {
+		ints.push_back(poly->elist[i]->verts[0]->index);
+		ints.push_back(poly->elist[i]->verts[1]->index);
+	}
+	for (int i = 0; i < nquads; i++)
+		for (int j = 0; j < 4; j++)
+			ints.push_back(poly->qlist[i]->edges[j]->index);
+
+	ints.push_back(0);
+	for (int i = 0; i < nverts; i++)
+		ints.push_back(ints.back() + poly->vlist[i]->nquads);
+	h.nvertex_quads = ints.back();
+	for (int i = 0; i < nverts; i++)
+		for (int j = 0; j < poly->vlist[i]->nquads; j++)
+			ints.push_back(poly->vlist[i]->quads[j]->index);
+
+	ints.push_back(0);
+	for (int i = 0; i < nverts; i++)
+		ints.push_back(ints.back() + poly->vlist[i]->nedges);
+	h.nvertex_edges = ints.back();
+	for (int i = 0; i < nverts; i++)
+		for (int j = 0; j < poly->vlist[i]->nedges; j++)
+			ints.push_back(poly->vlist[i]->edges[j]->index);
+
+	ints.push_back(0);
+	for (int i = 0; i < nedges; i++)
+		ints.push_back(ints.back() + poly->elist[i]->nquads);
+	h.nedge_quads = ints.back();
+	for (int i = 0; i < nedges; i++)
+		for (int j = 0; j < poly->elist[i]->nquads; j++)
+			ints.push_back(poly->elist[i]->quads[j]->index);
+
+	std::string path = cache_path(source_path);
+	FILE* file = fopen(path.c_str(), "wb");
+	if (file == NULL)
+		return false;
+
+	bool ok = fwrite(&h, sizeof(h), 1, file) == 1 &&
+		fwrite(doubles.data(), sizeof(double), doubles.size(), file) == doubles.size() &&
+		fwrite(areas.data(), sizeof(float), areas.size(), file) == areas.size() &&
+		fwrite(ints.data(), sizeof(int32_t), ints.size(), file) == ints.size();
+	ok = (fclose(file) == 0) && ok;
+
+	if (!ok)
+		remove(path.c_str());
+	return ok;
+}
+
+void initialize_cached(Polyhedron* poly, const char* source_path)
+{
+	/* a structured grid has no edges or rings to cache */
+	if (poly->grid) {
+		poly->initialize();
+		return;
+	}
+
+	if (read_topology_cache(poly, source_path))
+		return;
+
+	poly->initialize();
+	if (!write_topology_cache(poly, source_path))
+		fprintf(stderr, "Could not write the topology cache for %s.\n", source_path);
+}
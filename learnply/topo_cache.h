@@ -0,0 +1,49 @@
+/*
+
+Cached topology for Polyhedron::initialize
+
+Everything initialize() derives from a mesh (edges, vertex rings, lengths,
+normals, areas and the bounding sphere) is written next to the source file
+as <source>.topo and read back on the next load instead of being rebuilt.
+
+*/
+
+#ifndef __TOPO_CACHE_H__
+#define __TOPO_CACHE_H__
+
+#include <stdint.h>
+
+class Polyhedron;
+
+/// <summary>
+/// Bumped whenever the layout of a .topo file or anything initialize() computes changes.
+/// </summary>
+const unsigned int TOPO_CACHE_VERSION = 1;
+
+/// <summary>
+/// Identifies a source file by its size and a 64-bit FNV-1a hash of its contents, which is what every cache
+/// written next to a source checks before it trusts itself.
+/// </summary>
+/// <returns>False if the source can't be read.</returns>
+bool hash_source(const char* source_path, uint64_t* hash, uint64_t* size);
+
+/// <summary>
+/// Fills in everything Polyhedron::initialize() would from the cache next to source_path.
+/// The cache is only used if its version matches and it was written for exactly this source file.
+/// </summary>
+/// <returns>False if there's no usable cache; poly is untouched and still needs initialize().</returns>
+bool read_topology_cache(Polyhedron* poly, const char* source_path);
+
+/// <summary>
+/// Writes the cache for an initialized poly that was loaded from source_path.
+/// </summary>
+/// <returns>False if the cache file couldn't be written, e.g. on a read-only dataset directory, or poly is a structured grid.</returns>
+bool write_topology_cache(Polyhedron* poly, const char* source_path);
+
+/// <summary>
+/// Loads the cache if there is one, otherwise runs initialize() and writes the cache for next time.
+/// Structured grids initialize faster than a cache could be read and are never cached.
+/// </summary>
+void initialize_cached(Polyhedron* poly, const char* source_path);
+
+#endif /* __TOPO_CACHE_H__ */
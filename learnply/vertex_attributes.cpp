@@ -0,0 +1,164 @@
+/*
+
+Structure-of-arrays copy of the per vertex attributes
+
+*/
+
+#include <math.h>
+#include "polyhedron.h"
+#include "vertex_attributes.h"
+#include "cpu_features.h"
+
+void VertexAttributes::gather(Vertex** vlist, int nverts)
+{
+	x.resize(nverts);
+	y.resize(nverts);
+	z.resize(nverts);
+	vx.resize(nverts);
+	vy.resize(nverts);
+	vz.resize(nverts);
+	scalar.resize(nverts);
+	for (int i = 0; i < nverts; i++) {
+		Vertex* v = vlist[i];
+		x[i] = v->x;
+		y[i] = v->y;
+		z[i] = v->z;
+		vx[i] = v->vx;
+		vy[i] = v->vy;
+		vz[i] = v->vz;
+		scalar[i] = v->scalar;
+	}
+	gather_colors(vlist, nverts);
+}
+
+void VertexAttributes::gather_colors(Vertex** vlist, int nverts)
+{
+	R.resize(nverts);
+	G.resize(nverts);
+	B.resize(nverts);
+	for (int i = 0; i < nverts; i++) {
+		R[i] = (float)vlist[i]->R;
+		G[i] = (float)vlist[i]->G;
+		B[i] = (float)vlist[i]->B;
+	}
+}
+
+void VertexAttributes::clear()
+{
+	/* swap with empties so the memory is actually handed back */
+	std::vector<double>().swap(x);
+	std::vector<double>().swap(y);
+	std::vector<double>().swap(z);
+	std::vector<double>().swap(vx);
+	std::vector<double>().swap(vy);
+	std::vector<double>().swap(vz);
+	std::vector<double>().swap(scalar);
+	std::vector<float>().swap(R);
+	std::vector<float>().swap(G);
+	std::vector<float>().swap(B);
+}
+
+/******************************************************************************
+Scalar versions of the reductions, for CPUs without AVX2 and for the tails
+the vector loops leave over.
+******************************************************************************/
+
+static void bounds_scalar(const double* a, int n, double* lower, double* upper)
+{
+	double lo = a[0], hi = a[0];
+	for (int i = 1; i < n; i++) {
+		if (a[i] < lo)
+			lo = a[i];
+		if (a[i] > hi)
+			hi = a[i];
+	}
+	*lower = lo;
+	*upper = hi;
+}
+
+static double max_square_scalar(const double* vx, const double* vy, const double* vz, int n)
+{
+	double m = 0;
+	for (int i = 0; i < n; i++) {
+		double sq = vx[i] * vx[i] + vy[i] * vy[i] + vz[i] * vz[i];
+		if (sq > m)
+			m = sq;
+	}
+	return m;
+}
+
+#ifdef HAVE_X86
+
+/******************************************************************************
+AVX2 versions. Two accumulators per result so consecutive min/max
+instructions don't wait on each other.
+******************************************************************************/
+
+AVX2_TARGET static void bounds_avx2(const double* a, int n, double* lower, double* upper)
+{
+	__m256d lo0 = _mm256_set1_pd(a[0]), lo1 = lo0;
+	__m256d hi0 = lo0, hi1 = lo0;
+	int i = 0;
+	for (; i + 8 <= n; i += 8) {
+		__m256d v0 = _mm256_loadu_pd(a + i);
+		__m256d v1 = _mm256_loadu_pd(a + i + 4);
+		lo0 = _mm256_min_pd(lo0, v0);
+		lo1 = _mm256_min_pd(lo1, v1);
+		hi0 = _mm256_max_pd(hi0, v0);
+		hi1 = _mm256_max_pd(hi1, v1);
+	}
+	double lo[4], hi[4];
+	_mm256_storeu_pd(lo, _mm256_min_pd(lo0, lo1));
+	_mm256_storeu_pd(hi, _mm256_max_pd(hi0, hi1));
+
+	double tail_lo = a[0], tail_hi = a[0];
+	if (i < n)
+		bounds_scalar(a + i, n - i, &tail_lo, &tail_hi);
+	*lower = fmin(fmin(fmin(lo[0], lo[1]), fmin(lo[2], lo[3])), tail_lo);
+	*upper = fmax(fmax(fmax(hi[0], hi[1]), fmax(hi[2], hi[3])), tail_hi);
+}
+
+AVX2_TARGET static double max_square_avx2(const double* vx, const double* vy, const double* vz, int n)
+{
+	__m256d m0 = _mm256_setzero_pd(), m1 = m0;
+	int i = 0;
+	for (; i + 8 <= n; i += 8) {
+		__m256d x0 = _mm256_loadu_pd(vx + i), x1 = _mm256_loadu_pd(vx + i + 4);
+		__m256d y0 = _mm256_loadu_pd(vy + i), y1 = _mm256_loadu_pd(vy + i + 4);
+		__m256d z0 = _mm256_loadu_pd(vz + i), z1 = _mm256_loadu_pd(vz + i + 4);
+		/* multiplies and adds kept separate so the sums round exactly like the scalar loop */
+		__m256d s0 = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(x0, x0), _mm256_mul_pd(y0, y0)), _mm256_mul_pd(z0, z0));
+		__m256d s1 = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(x1, x1), _mm256_mul_pd(y1, y1)), _mm256_mul_pd(z1, z1));
+		m0 = _mm256_max_pd(m0, s0);
+		m1 = _mm256_max_pd(m1, s1);
+	}
+	double m[4];
+	_mm256_storeu_pd(m, _mm256_max_pd(m0, m1));
+	double tail = max_square_scalar(vx + i, vy + i, vz + i, n - i);
+	return fmax(fmax(fmax(m[0], m[1]), fmax(m[2], m[3])), tail);
+}
+
+#endif /* HAVE_X86 */
+
+void attribute_bounds(const double* a, int n, double* lower, double* upper)
+{
+	if (n <= 0)
+		return;
+#ifdef HAVE_X86
+	if (cpu_has_avx2()) {
+		bounds_avx2(a, n, lower, upper);
+		return;
+	}
+#endif
+	bounds_scalar(a, n, lower, upper);
+}
+
+double max_magnitude(const double* vx, const double* vy, const double* vz, int n)
+{
+	/* sqrt is monotonic, so the largest magnitude is the root of the largest square */
+#ifdef HAVE_X86
+	if (cpu_has_avx2())
+		return sqrt(max_square_avx2(vx, vy, vz, n));
+#endif
+	return sqrt(max_square_scalar(vx, vy, vz, n));
+}
@@ -0,0 +1,46 @@
+/*
+
+Structure-of-arrays copy of the per vertex attributes
+
+Vertex interleaves its coordinates, vector, scalar and color with its index,
+ring pointers and normal, so a pass over a single attribute pulls whole
+vertices through the cache. The store keeps one contiguous array per
+attribute, which the reductions below read with AVX2 where the CPU has it.
+
+*/
+
+#ifndef __VERTEX_ATTRIBUTES_H__
+#define __VERTEX_ATTRIBUTES_H__
+
+#include <vector>
+
+class Vertex;
+
+/// <summary>
+/// Attributes of vlist[i] are at [i] of each array. The arrays are a copy: after changing a Vertex,
+/// gather() (or gather_colors() for R, G, B) has to be called again for the store to see it.
+/// </summary>
+struct VertexAttributes {
+	std::vector<double> x, y, z;		/* coordinates */
+	std::vector<double> vx, vy, vz;		/* vector field */
+	std::vector<double> scalar;			/* scalar field */
+	std::vector<float> R, G, B;			/* color */
+
+	int size() const { return (int)x.size(); }
+
+	void gather(Vertex** vlist, int nverts);
+	void gather_colors(Vertex** vlist, int nverts);
+	void clear();
+};
+
+/// <summary>
+/// Smallest and largest of a[0..n). Leaves lower and upper alone if n is 0.
+/// </summary>
+void attribute_bounds(const double* a, int n, double* lower, double* upper);
+
+/// <summary>
+/// Largest |(vx[i], vy[i], vz[i])| over [0, n), or 0 if n is 0.
+/// </summary>
+double max_magnitude(const double* vx, const double* vy, const double* vz, int n);
+
+#endif /* __VERTEX_ATTRIBUTES_H__ */